@@ -0,0 +1,98 @@
+// bench.cc
+// Timings of the hot paths, for every unit cell over a range of sizes and p.
+// Built and run by make bench
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+
+#include "../heads/lattice.h"
+
+template<class S, class W>
+double measure(uint warm, uint reps, S setup, W work){
+/* Median time of work, in seconds, after some runs to warm up. setup is run
+ * before each, outside the timing
+ * warm  : number of untimed runs first
+ * reps  : number of timed runs
+ * setup : called with no arguments before each run
+ * work  : called with no arguments, and timed
+ */
+  std::vector<double> times;
+  std::chrono::steady_clock::time_point start;
+  for (uint i=0; i<warm+reps; i++){
+    setup();
+    start = std::chrono::steady_clock::now();
+    work();
+    if (i >= warm){
+      times.push_back(std::chrono::duration<double>(
+        std::chrono::steady_clock::now()-start).count());
+    }
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size()/2];
+}
+
+void report(const std::string& label, uint dim, double p,
+    const std::string& phase, double t, uint nv, uint ne){
+/* Print one timing as ns per vertex and ns per bond
+ */
+  std::cout << std::setw(16) << std::left << label << std::right <<
+    std::setw(5) << dim << std::setw(7) << p << "  " << std::setw(11) <<
+    std::left << phase << std::right << std::fixed << std::setprecision(3) <<
+    std::setw(10) << 1e9*t/nv << std::setw(10) << 1e9*t/ne <<
+    std::defaultfloat << std::endl;
+}
+
+int main(int argc, char** argv){
+  std::vector<lattice_t> cells = {lattices::cubic(), lattices::raussendorf(),
+    lattices::diamond(), lattices::diamond_grid()};
+  std::vector<uint> dims = {8, 16, 32};
+  std::vector<double> ps = {0.25, 0.4, 0.6, 1.};
+  uint warm=2, reps=9, seed=314, trial=0, minsizes[7];
+
+  if (argc>1){
+    reps=atoi(argv[1]);
+  }
+  reps = std::max(reps, 1u);
+
+  std::cout << "# median of " << reps << " runs after " << warm <<
+    " to warm up" << std::endl;
+  std::cout << "# cell dim p phase ns/vertex ns/bond" << std::endl;
+  for (auto& c : cells){
+    for (auto dim : dims){
+      double t = measure(warm, reps, []{}, [&]{
+        lattice L(c, dim, dim, dim);
+      });
+      lattice L(c, dim, dim, dim);
+      uint nv=L.vertices(), ne=L.bonds();
+      report(c.label, dim, NAN, "construct", t, nv, ne);
+      for (auto p : ps){
+        t = measure(warm, reps, [&]{trial++;}, [&]{
+          L.percolate(p, seed, trial);
+        });
+        report(c.label, dim, p, "percolate", t, nv, ne);
+        for (uint d=0; d<6; d++){
+          t = measure(warm, reps, [&]{L.reset();}, [&]{
+            L.bfs(L.face(d), d);
+          });
+          report(c.label, dim, p, "bfs " + std::to_string(d), t, nv, ne);
+        }
+        t = measure(warm, reps, [&]{L.reset();}, [&]{
+          L.traverse(true);
+        });
+        report(c.label, dim, p, "bfs fused", t, nv, ne);
+        L.reset();
+        L.traverse();
+        t = measure(warm, reps, []{}, [&]{
+          L.crossings(minsizes);
+        });
+        report(c.label, dim, p, "crossings", t, nv, ne);
+      }
+    }
+  }
+  return 0;
+}
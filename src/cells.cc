@@ -0,0 +1,61 @@
+/* cells.cc
+ * Compile-time unit cells
+ * - Storage for the constant tables (needed by C++11 when they are odr-used)
+ * - Lookup from runtime unit cell to compile-time cell
+ */
+
+#include "heads/cells.h"
+
+constexpr cells::link cells::cubic::adj[];
+constexpr uint cells::cubic::startx[];
+constexpr uint cells::cubic::starty[];
+constexpr uint cells::cubic::startz[];
+constexpr uint cells::cubic::endx[];
+constexpr uint cells::cubic::endy[];
+constexpr uint cells::cubic::endz[];
+
+constexpr cells::link cells::raussendorf::adj[];
+constexpr uint cells::raussendorf::startx[];
+constexpr uint cells::raussendorf::starty[];
+constexpr uint cells::raussendorf::startz[];
+constexpr uint cells::raussendorf::endx[];
+constexpr uint cells::raussendorf::endy[];
+constexpr uint cells::raussendorf::endz[];
+
+constexpr cells::link cells::diamond::adj[];
+constexpr uint cells::diamond::startx[];
+constexpr uint cells::diamond::starty[];
+constexpr uint cells::diamond::startz[];
+constexpr uint cells::diamond::endx[];
+constexpr uint cells::diamond::endy[];
+constexpr uint cells::diamond::endz[];
+
+constexpr cells::link cells::diamond_grid::adj[];
+constexpr uint cells::diamond_grid::startx[];
+constexpr uint cells::diamond_grid::starty[];
+constexpr uint cells::diamond_grid::startz[];
+constexpr uint cells::diamond_grid::endx[];
+constexpr uint cells::diamond_grid::endy[];
+constexpr uint cells::diamond_grid::endz[];
+
+uint cells::lookup(const lattice_t& D){
+/* Dispatch table from runtime unit cell to compile-time cell. A cell is only
+ * matched if it is the same in every detail (see same), so one that merely
+ * shares a name with a built-in cell gets the runtime kernel
+ * D : unit cell
+ * returns the index of the cell counting from 1, or 0 if D is none of them
+ */
+  if (same<cubic>(D)){
+    return 1;
+  }
+  if (same<raussendorf>(D)){
+    return 2;
+  }
+  if (same<diamond>(D)){
+    return 3;
+  }
+  if (same<diamond_grid>(D)){
+    return 4;
+  }
+  return 0;
+}
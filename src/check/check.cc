@@ -0,0 +1,622 @@
+// check.cc
+// Cross-checks between the different ways the code has of getting the same
+// answer, on small lattices with fixed seeds. Built and run by make check,
+// which fails if any of them disagree
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdio>
+#include <type_traits>
+
+#include "../heads/lattice.h"
+#include "../heads/implicit.h"
+#include "../heads/slabs.h"
+#include "../heads/results.h"
+#include "../heads/shard.h"
+
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <csignal>
+
+// Moves allocate nothing and cannot throw, so vectors of lattices move them
+// when they grow rather than copying
+static_assert(std::is_nothrow_move_constructible<lattice>::value &&
+  std::is_nothrow_move_assignable<lattice>::value &&
+  std::is_nothrow_move_constructible<lattice_t>::value &&
+  std::is_nothrow_move_assignable<lattice_t>::value,
+  "moves of lattice and lattice_t must be noexcept");
+
+bool report(const std::string& name, uint bad, uint total){
+/* Print the outcome of one check
+ * name  : what was checked
+ * bad   : number of comparisons which disagreed
+ * total : number of comparisons
+ * returns whether they all agreed
+ */
+  std::cout << (bad ? "FAIL " : "ok   ") << name << ": " << bad << " of " <<
+    total << " disagree" << std::endl;
+  return bad == 0;
+}
+
+bool spanning(void){
+/* Union-find (findSpanning) finds a crossing cluster exactly where the bfs
+ * (findCrossings) does. Only for unit cells whose bonds can be followed both
+ * ways: the bfs follows the one-way bonds of diamond_grid in one direction
+ * only, while union-find joins their ends regardless
+ */
+  std::vector<lattice_t> cells = {lattices::cubic(), lattices::raussendorf(),
+    lattices::diamond()};
+  std::vector<uint> sizes;
+  std::vector<bool> spans;
+  uint bad=0, total=0;
+  for (auto& c : cells){
+    for (uint dim=1; dim<=6; dim++){
+      lattice L(c, dim, dim+1, dim+2);
+      for (uint t=0; t<40; t++){
+        L.percolate(0.1+0.9*t/40, 314, t);
+        L.reset();
+        L.traverse();
+        sizes = L.findCrossings();
+        spans = L.findSpanning();
+        for (uint k=0; k<7; k++){
+          bad += (sizes[k] != (uint)-1) != spans[k];
+          total++;
+        }
+      }
+    }
+  }
+  return report("findSpanning against findCrossings", bad, total);
+}
+
+bool blocks(void){
+/* Bit k of a block of 64 trials (percolate64, findSpanning64) crosses exactly
+ * where trial first+k on its own (percolate, findCrossings) does, for every
+ * unit cell including diamond_grid: both follow the bonds forwards only
+ */
+  std::vector<lattice_t> cells = {lattices::cubic(), lattices::raussendorf(),
+    lattices::diamond(), lattices::diamond_grid()};
+  std::vector<uint> sizes;
+  std::vector<uint64_t> spans;
+  uint bad=0, total=0, first;
+  for (auto& c : cells){
+    for (uint dim=1; dim<=4; dim++){
+      lattice L(c, dim, dim+1, dim+2);
+      for (double p : {0.0, 0.2, 0.35, 0.5, 0.7, 1.0}){
+        first = 1000*dim+64*(uint)(10*p);
+        L.percolate64(p, 314, first);
+        spans = L.findSpanning64();
+        for (uint k=0; k<64; k++){
+          L.percolate(p, 314, first+k);
+          L.reset();
+          L.traverse();
+          sizes = L.findCrossings();
+          for (uint j=0; j<7; j++){
+            bad += (sizes[j] != (uint)-1) != (spans[j]>>k & 1);
+            total++;
+          }
+        }
+      }
+    }
+  }
+  return report("blocks of 64 trials against single trials", bad, total);
+}
+
+bool distances(void){
+/* The bfs one direction at a time, which does some levels bottom-up on
+ * symmetric graphs (see graph::search), gives the same distances as the
+ * fused bfs, which is top-down only. Thin slabs are included since their
+ * frontiers take in most of what is left, so they switch to bottom-up early
+ */
+  std::vector<lattice_t> cells = {lattices::cubic(), lattices::raussendorf(),
+    lattices::diamond(), lattices::diamond_grid()};
+  std::vector<std::vector<uint> > shapes = {{1,2,3}, {4,5,6}, {16,16,1},
+    {12,2,12}, {3,20,20}};
+  std::vector<uint> dist;
+  uint bad=0, total=0;
+  for (auto& c : cells){
+    for (auto& s : shapes){
+      lattice L(c, s[0], s[1], s[2]);
+      for (uint t=0; t<10; t++){
+        L.percolate(0.3+0.7*t/9, 314, t);
+        L.reset();
+        L.traverse();
+        dist.clear();
+        for (uint d=0; d<6; d++){
+          for (uint v=0; v<L.vertices(); v++){
+            dist.push_back(L.distance(d, v));
+          }
+        }
+        L.reset();
+        L.traverse(true);
+        for (uint d=0; d<6; d++){
+          for (uint v=0; v<L.vertices(); v++){
+            bad += L.distance(d, v) != dist[d*L.vertices()+v];
+            total++;
+          }
+        }
+      }
+    }
+  }
+  return report("bfs by direction against fused bfs", bad, total);
+}
+
+bool impostors(void){
+/* A unit cell built at runtime with the name of a built-in one, but not the
+ * same cell, runs the runtime kernel: it finds the same as an identical cell
+ * under another name, not what the compiled-in cell of that name would
+ */
+  std::vector<lattice_t> named, renamed;
+  std::vector<uint> a, b;
+  uint bad=0, total=0;
+  lattice_t flat(1, "cubic");     // Cubic without the z bonds
+  flat.add(0, 0,-1,0,0);
+  flat.add(0, 0,1,0,0);
+  flat.add(0, 0,0,-1,0);
+  flat.add(0, 0,0,1,0);
+  flat.startx = flat.starty = flat.startz = {0};
+  flat.endx = flat.endy = flat.endz = {0};
+  named.push_back(flat);
+  lattice_t turned = lattices::diamond();   // Diamond with x faces swapped
+  std::swap(turned.startx, turned.endx);
+  named.push_back(turned);
+  for (auto c : named){
+    c.label = "impostor";
+    renamed.push_back(c);
+  }
+  for (uint k=0; k<named.size(); k++){
+    for (uint t=0; t<20; t++){
+      implicit I(named[k], 3, 4, 5), J(renamed[k], 3, 4, 5);
+      I.percolate(0.3+0.7*t/19, 314, t);
+      J.percolate(0.3+0.7*t/19, 314, t);
+      for (uint64_t n=0; n<I.vertices(); n++){
+        for (uint i=0; i<8; i++){
+          bad += I.isOpen(n, i) != J.isOpen(n, i);
+        }
+      }
+      I.traverse();
+      J.traverse();
+      a = I.findCrossings();
+      b = J.findCrossings();
+      bad += a != b;
+      total += 8*I.vertices()+1;
+    }
+  }
+  return report("runtime cells named as built-in ones", bad, total);
+}
+
+bool slabbed(void){
+/* The out-of-core slabs, at several depths of slab, find the same crossing
+ * clusters as implicit, which keeps every distance in memory. Both number
+ * their bonds the same way, so draw the same bonds for a trial
+ */
+  std::vector<lattice_t> cells = {lattices::cubic(), lattices::raussendorf(),
+    lattices::diamond(), lattices::diamond_grid()};
+  const char* file = "check.slabs";
+  std::vector<uint> a, b;
+  uint bad=0, total=0;
+  for (auto& c : cells){
+    for (uint dim=1; dim<=5; dim++){
+      for (uint t=0; t<12; t++){
+        double p = 0.2+0.8*t/11;
+        implicit I(c, dim+1, dim, dim+2);
+        slabs S(c, dim+1, dim, dim+2, file, 1+t%3);
+        I.percolate(p, 314, t);
+        S.percolate(p, 314, t);
+        I.traverse();
+        S.traverse();
+        a = I.findCrossings();
+        b = S.findCrossings();
+        bad += a != b;
+        total++;
+      }
+    }
+  }
+  std::remove(file);
+  return report("slabs against implicit", bad, total);
+}
+
+bool coupled(void){
+/* Raising one trial through increasing p and repairing the distances (see
+ * graph::couple) gives, at every p, the same distances and crossing clusters
+ * as percolating that trial afresh at that p and searching from scratch
+ */
+  std::vector<lattice_t> cells = {lattices::cubic(), lattices::raussendorf(),
+    lattices::diamond(), lattices::diamond_grid()};
+  uint a[7], b[7], bad=0, total=0;
+  for (auto& c : cells){
+    for (uint dim=1; dim<=6; dim++){
+      lattice L(c, dim, dim+1, dim+2), K(L);
+      for (uint t=0; t<4; t++){
+        L.couple(314, t);
+        L.reset();
+        L.traverse();
+        for (double p=0.1; p<1.05; p+=0.05){
+          L.raise(p);
+          L.repair();
+          L.crossings(a);
+          K.percolate(p, 314, t);
+          K.reset();
+          K.traverse();
+          K.crossings(b);
+          for (uint d=0; d<6; d++){
+            for (uint v=0; v<L.vertices(); v++){
+              bad += L.distance(d, v) != K.distance(d, v);
+            }
+          }
+          bad += !std::equal(a, a+7, b);
+          total += 6*L.vertices()+1;
+        }
+      }
+    }
+  }
+  return report("coupled sweep against fresh trials", bad, total);
+}
+
+bool queries(void){
+/* Asking for only some crossing clusters (findCrossings(which)), or for one
+ * by bidirectional search (cross), gives the same answers as finding them
+ * all
+ */
+  std::vector<lattice_t> cells = {lattices::cubic(), lattices::raussendorf(),
+    lattices::diamond(), lattices::diamond_grid()};
+  std::vector<uint> all, some;
+  uint bad=0, total=0;
+  for (auto& c : cells){
+    for (uint dim=1; dim<=6; dim++){
+      lattice L(c, dim, dim+1, dim+2);
+      for (uint t=0; t<20; t++){
+        L.percolate(0.1+0.9*t/19, 314, t);
+        L.reset();
+        L.traverse();
+        all = L.findCrossings();
+        for (uint which=1; which<128; which++){
+          some = L.findCrossings(which);
+          for (uint k=0; k<7; k++){
+            bad += some[k] != ((which>>k & 1) ? all[k] : (uint)-1);
+            total++;
+          }
+        }
+        for (uint a=0; a<3; a++){
+          bad += L.cross(a) != all[a];
+          bad += (L.cross(a, false) == 0) != (all[a] != (uint)-1);
+          total += 2;
+        }
+      }
+    }
+  }
+  return report("findCrossings(which) and cross against findCrossings", bad,
+    total);
+}
+
+template<typename T>
+uint scan(uint64_t n, uint32_t top, uint trial, uint* total){
+/* One comparison for kernel: the four-wide lattice::crossings against
+ * lattice::crossing one vertex at a time, on random distances of type T
+ * n     : number of vertices
+ * top   : distances are below top. A quarter are unvisited instead
+ * trial : trial number for the random distances
+ * total : incremented by the number of comparisons
+ * returns the number which disagree
+ */
+  philox r(314, trial);
+  std::vector<T> dist[6];
+  const T* ptrs[6];
+  uint a[7], b[7], distance[6], bad=0;
+  for (uint d=0; d<6; d++){
+    for (uint64_t i=0; i<n; i++){
+      uint32_t x = r.get(d*n+i);
+      dist[d].push_back(x%4 ? (T)((x>>2)%top) : (T)-1);
+    }
+    ptrs[d] = dist[d].data();
+  }
+  std::fill(a, a+7, (uint)-1);
+  std::fill(b, b+7, (uint)-1);
+  lattice::crossings(ptrs, n, a);
+  for (uint64_t i=0; i<n; i++){
+    for (uint d=0; d<6; d++){
+      distance[d] = dist[d][i]==(T)-1 ? (uint)-1 : dist[d][i];
+    }
+    lattice::crossing(distance, b);
+  }
+  for (uint k=0; k<7; k++){
+    bad += a[k] != b[k];
+  }
+  *total += 7;
+  return bad;
+}
+
+bool kernel(void){
+/* The vectorised scan for the smallest crossing clusters gives the same
+ * sizes as the scalar one, for both widths of distance, small and large
+ * distances, and numbers of vertices which are not a multiple of four
+ */
+  uint bad=0, total=0, trial=0;
+  for (uint64_t n=0; n<=40; n++){
+    for (uint32_t top : {4u, 100u, 0xFFFEu}){
+      bad += scan<uint16_t>(n, top, trial++, &total);
+      bad += scan<uint32_t>(n, top, trial++, &total);
+    }
+  }
+  bad += scan<uint16_t>(100000, 0xFFFE, trial++, &total);
+  bad += scan<uint32_t>(100000, 1u<<28, trial++, &total);
+  return report("vectorised crossings against crossing", bad, total);
+}
+
+bool dense(void){
+/* A unit cell with more neighbours per vertex than the bond state has room
+ * for is refused by throwing std::invalid_argument, not by ending the
+ * process, and lattices can still be built afterwards
+ */
+  lattice_t D(1, "dense");
+  int steps[9][3] = {{1,0,0}, {0,1,0}, {0,0,1}, {-1,0,0}, {0,-1,0}, {0,0,-1},
+    {1,1,0}, {0,1,1}, {1,0,1}};
+  uint bad=0;
+  for (auto& s : steps){
+    D.add(0, 0, s[0], s[1], s[2]);
+  }
+  try{
+    lattice L(D, 3, 3, 3);
+    bad++;
+  }
+  catch (const std::invalid_argument&){
+  }
+  try{
+    implicit I(D, 3, 3, 3);
+    bad++;
+  }
+  catch (const std::invalid_argument&){
+  }
+  lattice L(lattices::cubic(), 3, 3, 3);
+  bad += L.bonds() != 54;
+  return report("more than 8 neighbours refused", bad, 3);
+}
+
+bool refused(void){
+/* slabs refuses a unit cell whose bonds skip a z layer, and a scratch file it
+ * cannot create, by throwing, and can still be built afterwards
+ */
+  const char* file = "check.slabs";
+  lattice_t D(1, "tall");
+  uint bad=0;
+  D.add(0, 0, 0, 0, 2);
+  D.add(0, 0, 0, 0, -2);
+  try{
+    slabs S(D, 3, 3, 6, file);
+    bad++;
+  }
+  catch (const std::invalid_argument&){
+  }
+  try{
+    slabs S(lattices::cubic(), 3, 3, 3, "check.missing/check.slabs");
+    bad++;
+  }
+  catch (const std::system_error&){
+  }
+  {
+    slabs S(lattices::cubic(), 3, 3, 3, file);
+    S.percolate(1, 314, 0);
+    S.traverse();
+    bad += S.findCrossings()[6] == (uint)-1;
+  }
+  std::remove(file);
+  return report("slabs refuse bad cells and files", bad, 3);
+}
+
+bool resume(void){
+/* A results file gives back exactly the trials put in it when opened again
+ * for the same sweep, drops a chunk cut short as by a killed job, and is
+ * moved aside, not written over, when opened for a different sweep. Errors
+ * are handed back to the caller
+ */
+  const char* file = "check.results";
+  const char* moved = "check.results.1";
+  std::vector<double> ps = {0.3, 0.5};
+  std::vector<uint> put(3*2*8), got;
+  uint dims[3] = {2, 3, 4}, nreps=8, bad=0, total=0;
+  uint32_t torn[5] = {0x6b6e6863, 5, 1, 2, 3};   // "chnk", 5 trials, cut off
+  struct stat st;
+  rlimit limit;
+  off_t whole;
+  std::remove(file);
+  std::remove(moved);
+  for (uint k=0; k<put.size(); k++){
+    put[k] = (k%7 == 0) ? (uint)-1 : 100+k;
+  }
+  got.assign(put.size(), 0);
+  {
+    // Every other trial
+    results R(file, "cubic", dims, 314, nreps, ps, true, got.data());
+    for (uint t=0; t<16; t+=2){
+      R.put(t, &put[3*t]);
+    }
+    R.close();
+  }
+  stat(file, &st);
+  whole = st.st_size;
+  FILE* f = fopen(file, "ab");
+  fwrite(torn, sizeof(torn), 1, f);
+  fclose(f);
+  got.assign(put.size(), 0);
+  {
+    results R(file, "cubic", dims, 314, nreps, ps, true, got.data());
+    stat(file, &st);
+    bad += R.count() != 8 || st.st_size != whole;
+    for (uint t=0; t<16; t++){
+      bad += R.has(t) != (t%2 == 0);
+      if (t%2 == 0){
+        bad += !std::equal(&put[3*t], &put[3*t+3], &got[3*t]);
+      }
+      else{
+        R.put(t, &put[3*t]);
+      }
+    }
+    total += 1+16+8;
+  }
+  got.assign(put.size(), 0);
+  {
+    results R(file, "cubic", dims, 314, nreps, ps, true, got.data());
+    bad += R.count() != 16 || got != put;
+    total++;
+  }
+  got.assign(put.size(), 0);
+  {
+    results R(file, "cubic", dims, 315, nreps, ps, true, got.data());
+    bad += R.count() != 0 || stat(moved, &st) != 0;
+    total++;
+  }
+  got.assign(put.size(), 0);
+  {
+    results R(moved, "cubic", dims, 314, nreps, ps, true, got.data());
+    bad += R.count() != 16 || got != put;
+    total++;
+  }
+  // A file which cannot be opened throws, rather than ending the process
+  try{
+    results R("check.missing/check.results", "cubic", dims, 314, nreps, ps,
+      true, got.data());
+    bad++;
+  }
+  catch (const std::system_error&){
+  }
+  total++;
+  // A write which fails, here by going over the file size limit, is handed
+  // back by close and put, and the file still opens with what it has
+  std::remove(file);
+  signal(SIGXFSZ, SIG_IGN);
+  getrlimit(RLIMIT_FSIZE, &limit);
+  {
+    results R(file, "cubic", dims, 314, nreps, ps, true, got.data());
+    stat(file, &st);
+    rlimit small = limit;
+    small.rlim_cur = st.st_size+100;
+    setrlimit(RLIMIT_FSIZE, &small);
+    for (uint t=0; t<16; t++){
+      R.put(t, &put[3*t]);
+    }
+    bad += R.close() || R.error() == 0 || R.put(0, &put[0]);
+    setrlimit(RLIMIT_FSIZE, &limit);
+  }
+  signal(SIGXFSZ, SIG_DFL);
+  {
+    results R(file, "cubic", dims, 314, nreps, ps, true, got.data());
+    bad += R.count() != 0;
+  }
+  total += 2;
+  std::remove(file);
+  std::remove(moved);
+  return report("results file resumed, torn, moved aside and failing", bad,
+    total);
+}
+
+bool sharding(void){
+/* A sweep served to worker processes comes back whole, and everyone gets to
+ * finish: one worker dies holding a unit, one names another sweep and is
+ * refused, one is waiting to connect when serve starts, one joins in the
+ * middle and one only tries once serve has returned. Then a sweep whose
+ * workers all die or are refused is given up, rather than waited on. A
+ * worker left waiting for a coordinator which has finished, or a coordinator
+ * waiting for workers which have gone, would hang the check until the alarm
+ * kills it
+ */
+  const char* sock = "check.sock";
+  const uint nunits=40, unitsize=2;
+  std::vector<shard::unit> units(nunits);
+  std::vector<uint> sizes(3*nunits*unitsize, 0);
+  std::vector<pid_t> children;
+  uint bad=0, total=0;
+  int after[2], status;
+  auto body = [](const shard::unit& u, uint* sizes){
+    for (uint k=0; k<3*u.count; k++){
+      sizes[k] = u.seed+3*u.first+k;
+    }
+    usleep(2000);
+  };
+  auto dies = [](const shard::unit&, uint*){ _exit(0); };
+  auto other = [&](){
+    if (!freopen("/dev/null", "w", stderr)){
+      _exit(1);
+    }
+    _exit(shard::work(sock, "other", body) ? 1 : 0);
+  };
+  auto worker = [&](const std::function<void(void)>& f){
+    pid_t pid = fork();
+    if (pid == 0){
+      f();
+      _exit(0);
+    }
+    children.push_back(pid);
+  };
+  for (uint u=0; u<nunits; u++){
+    units[u].id = u;
+    units[u].seed = 7;
+    units[u].first = u*unitsize;
+    units[u].count = unitsize;
+    units[u].p = 0.5;
+  }
+  if (pipe(after) != 0){
+    return report("sharded sweep with dead, late and refused workers", 1, 1);
+  }
+  alarm(60);
+  {
+    shard S(sock, "check");
+    worker([&](){ shard::work(sock, "check", dies); });
+    worker(other);
+    worker([&](){ shard::work(sock, "check", body); });
+    worker([&](){ usleep(20000); shard::work(sock, "check", body); });
+    worker([&](){
+      char c;
+      close(after[1]);
+      while (read(after[0], &c, 1) > 0);
+      if (!freopen("/dev/null", "w", stderr)){
+        _exit(1);
+      }
+      shard::work(sock, "check", body);
+    });
+    close(after[0]);
+    bad += !S.serve(units, sizes.data(), &children);
+    total++;
+    close(after[1]);
+    for (auto pid : children){
+      bad += waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0;
+      total++;
+    }
+  }
+  {
+    shard S(sock, "check");
+    children.clear();
+    worker([&](){ shard::work(sock, "check", dies); });
+    worker(other);
+    bad += S.serve(units, std::vector<uint>(sizes.size()).data(), &children);
+    bad += !children.empty();
+    total += 2;
+  }
+  alarm(0);
+  for (uint k=0; k<sizes.size(); k++){
+    bad += sizes[k] != 7+k;
+  }
+  total += sizes.size();
+  return report("sharded sweep with dead, late and refused workers", bad,
+    total);
+}
+
+int main(void){
+  bool ok=true;
+  ok = spanning() && ok;
+  ok = blocks() && ok;
+  ok = distances() && ok;
+  ok = slabbed() && ok;
+  ok = impostors() && ok;
+  ok = coupled() && ok;
+  ok = queries() && ok;
+  ok = kernel() && ok;
+  ok = dense() && ok;
+  ok = refused() && ok;
+  ok = resume() && ok;
+  ok = sharding() && ok;
+  return ok ? 0 : 1;
+}
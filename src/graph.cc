@@ -2,211 +2,816 @@
  * Graph class
  * - Base class for graphs
  * - No knowledge of underlying structure of graph
- * - Adjacency table representation (less suitable for very dense graphs)
+ * - Compressed sparse row adjacency (less suitable for very dense graphs)
  */
 
 #include "heads/graph.h"
 
-//--------------------VERTEX CLASS--------------------------------------------//
+//--------------------GRAPH CLASS---------------------------------------------//
 
-graph::vertex::vertex(void){
-/* Empty constructor for vertex object. Initialises to completely unconnected
- * state with bfs variables set to defaults.
+graph::graph(void) noexcept{
+/* Empty constructor for graph class.
+ * Creates graph with zero vertices and no adjacency. Needs no arena (see
+ * place), so allocates nothing
  */
-  for (uint i=0; i<6; i++){
-    parent[i] = this;
-    visited[i] = false;
-    distance[i] = -1;
-    clusterid[i] = 0;
+  size = nslots = nbonds = 0;
+  symmetric = true;
+  rank = 0;
+  wide = false;
+  place();
+}
+
+graph::graph(uint n){
+/* Size constructor for graph class
+ * Creates a graph with n vertices and no adjacency
+ */
+  size = n;
+  queue.reserve(size);
+  rank = 0;
+  wide = false;
+  build(std::vector<uint32_t>(size+1, 0), std::vector<uint32_t>());
+  reset();
+}
+
+graph::graph(const graph& G){
+/* Copy constructor for graph class
+ * Creates a new graph as a copy of graph G. The topology is not copied but
+ * shared with G; only the bond and bfs state are the new graph's own
+ */
+  size = G.size;
+  nslots = G.nslots;
+  nbonds = G.nbonds;
+  arena = G.arena;
+  place();
+  symmetric = G.symmetric;
+  open64 = G.open64;
+  mask = G.mask;
+  open = G.open;
+  order = G.order;
+  rank = G.rank;
+  wide = G.wide;
+  for (uint d=0; d<6; d++){
+    dist16[d] = G.dist16[d];
+    dist32[d] = G.dist32[d];
   }
+  queue.reserve(size);
 }
 
-void graph::vertex::percolate(double q, gsl_rng* r){
-/* Delete outgoing edges probabilistically with probability q.
- * If an edge to vertex v is deleted, this method dereferences the pointer and
- * also deletes the edge from that vertex.
- * q : Probability of deletion
- * r : (initialised) GSL random number generator.
+graph::graph(graph&& G) noexcept{
+/* Move constructor for graph class
+ * Takes over the storage of graph G, leaving it with zero vertices. Only
+ * pointers change hands, so nothing is allocated and it cannot fail
  */
-  vertex* in, *out;
-  uint j;
-  for (uint i=0; i<adj.size(); i++){
-    if (gsl_rng_uniform(r) < q){
-      out = adj[i];
-      adj.erase(adj.begin()+i);
-      i--;
-      // Erase incoming connection
-      j = 0;
-      do{
-        in = out->adj[j];
-        j++;
-      } while (in != this);
-      out->adj.erase(out->adj.begin()+j-1);
-    }
+  size = nslots = nbonds = 0;
+  symmetric = true;
+  rank = 0;
+  wide = false;
+  place();
+  swap(G);
+}
+
+graph::~graph(void){
+/* Destructor for graph class. Empty because the arena is freed with the last
+ * graph sharing it, and everything else is in vectors
+ */
+}
+
+graph& graph::operator=(const graph &G){
+/* Assignment operator
+ * Assigns state of graph object to that of graph G. Returns self.
+ */
+  if (this == &G){
+    return *this;
   }
+  size = G.size;
+  nslots = G.nslots;
+  nbonds = G.nbonds;
+  arena = G.arena;
+  place();
+  symmetric = G.symmetric;
+  open64 = G.open64;
+  mask = G.mask;
+  open = G.open;
+  order = G.order;
+  rank = G.rank;
+  wide = G.wide;
+  for (uint d=0; d<6; d++){
+    dist16[d] = G.dist16[d];
+    dist32[d] = G.dist32[d];
+  }
+  queue.reserve(size);
+  return *this;
 }
 
-void graph::vertex::reset(void){
-/* Reset vertex to its default state.
- * This resets all the bfs variables to: self-parent, not visited, distance
- * -1, cluster id 0.
- * Adjacency list is not affected, since the graph object has no default
- * connectivity.
+graph& graph::operator=(graph&& G) noexcept{
+/* Move assignment operator
+ * Takes over the storage of graph G, which is left with the old state of this
+ * graph to free. Returns self.
  */
-  for (uint i=0; i<6; i++){
-    parent[i] = this;
-    visited[i] = false;
-    distance[i] = -1;
-    clusterid[i] = 0;
+  swap(G);
+  return *this;
+}
+
+void graph::swap(graph& G) noexcept{
+/* Exchange the whole state of this graph with that of graph G. Only pointers
+ * change hands, so the topology does not move in memory
+ */
+  std::swap(size, G.size);
+  arena.swap(G.arena);
+  std::swap(nslots, G.nslots);
+  std::swap(nbonds, G.nbonds);
+  std::swap(offsets, G.offsets);
+  std::swap(nbrs, G.nbrs);
+  std::swap(eid, G.eid);
+  std::swap(ends, G.ends);
+  std::swap(symmetric, G.symmetric);
+  std::swap(rank, G.rank);
+  std::swap(wide, G.wide);
+  queue.swap(G.queue);
+  frontier.swap(G.frontier);
+  packed.swap(G.packed);
+  front.swap(G.front);
+  rest.swap(G.rest);
+  sides.swap(G.sides);
+  sources.swap(G.sources);
+  mask.swap(G.mask);
+  open.swap(G.open);
+  order.swap(G.order);
+  added.swap(G.added);
+  open64.swap(G.open64);
+  for (uint d=0; d<6; d++){
+    dist16[d].swap(G.dist16[d]);
+    dist32[d].swap(G.dist32[d]);
   }
 }
 
-//--------------------GRAPH CLASS---------------------------------------------//
+void graph::place(void){
+/* Point offsets, nbrs, eid and ends at their parts of the arena, which must
+ * already hold size+1, nslots, nslots and 2*nbonds words for them. A graph
+ * with no vertices and no arena gets the single word it needs from a static
+ */
+  static const uint32_t none = 0; // offsets of an empty graph
+  offsets = arena ? arena.get() : &none;
+  nbrs = offsets+size+1;
+  eid = nbrs+nslots;
+  ends = eid+nslots;
+}
 
-graph::graph(void){
-/* Empty constructor for graph class.
- * Creates graph with zero vertices and no adjacency
+void graph::reset(){
+/* Reset graph to original state. Just marks every vertex as unvisited in
+ * every direction. Cannot change the adjacency since there is no default for
+ * a graph object.
  */
-  size = 0;
-  adj = new vertex[size];
+  for (uint d=0; d<6; d++){
+    if (wide){
+      dist32[d].assign(size, (uint32_t)-1);
+    }
+    else{
+      dist16[d].assign(size, (uint16_t)-1);
+    }
+  }
 }
 
-graph::graph(uint n){
-/* Size constructor for graph class
- * Creates a graph with n vertices and no adjacency
+void graph::widen(void){
+/* Move the distances from 16 to 32 bits, keeping their values. Once widened,
+ * a graph stays wide.
  */
-  size = n;
-  adj = new vertex[size];
-  reset();
+  for (uint d=0; d<6; d++){
+    dist32[d].resize(size);
+    for (uint i=0; i<size; i++){
+      dist32[d][i] = (dist16[d][i]==(uint16_t)-1) ? (uint32_t)-1 : dist16[d][i];
+    }
+    std::vector<uint16_t>().swap(dist16[d]);
+  }
+  wide = true;
 }
 
-graph::graph(const graph& G){
-/* Copy constructor for graph class
- * Creates a new graph as a copy of graph G
+void graph::build(const std::vector<uint32_t>& rows,
+    const std::vector<uint32_t>& adj){
+/* Lay out the topology in a new arena, and number its undirected bonds. Any
+ * old arena is left to the other graphs sharing it, if there are any. Each
+ * slot i -> j is paired with an unpaired slot j -> i if there is one, and the
+ * pair becomes a single bond. Bonds are numbered in order of their first
+ * slot.
+ * There may be at most 8 neighbours per vertex, as the open slots of each are
+ * kept in a byte (see open). Anything more is refused by throwing
+ * std::invalid_argument, before the graph is changed, so a caller building
+ * graphs it did not choose can catch it and carry on.
+ * rows : start of each row in adj (size+1 entries)
+ * adj  : indices of adjacent vertices, row by row
  */
-  size = G.size;
-  adj = new vertex[size];
-  vertex *u, *v;
-  uint n;
+  std::vector<uint32_t> slots(adj.size(), (uint32_t)-1), pairs;
+  uint32_t* block;
+  uint j, e;
   for (uint i=0; i<size; i++){
-    // Copy the vertex manually
-    u = adj+i;
-    v = G.adj+i;
-    for (uint i=0; i<6; i++){
-      u->visited[i] = v->visited[i];
-      u->distance[i] = v->distance[i];
-      u->parent[i] = u+(v->parent[i]-v);
-      u->clusterid[i] = v->clusterid[i];
+    if (rows[i+1]-rows[i] > 8){
+      throw std::invalid_argument("graph: vertex " + std::to_string(i) +
+        " has more than 8 neighbours");
     }
-    n = v->adj.size();
-    for (uint j=0; j<n; j++){
-      u->add(u+(v->adj[j]-v)); // Retain relative positions
+  }
+  for (uint i=0; i<size; i++){
+    for (uint s=rows[i]; s<rows[i+1]; s++){
+      if (slots[s] != (uint32_t)-1){
+        continue;
+      }
+      j = adj[s];
+      e = pairs.size()/2;
+      slots[s] = e;
+      pairs.push_back(i);
+      pairs.push_back(j);
+      for (uint t=rows[j]; t<rows[j+1]; t++){
+        if (adj[t] == i && slots[t] == (uint32_t)-1){
+          slots[t] = e;
+          break;
+        }
+      }
     }
   }
+  nslots = adj.size();
+  nbonds = pairs.size()/2;
+  block = (uint32_t*)malloc((size+1+2*(uint64_t)nslots+2*nbonds)*
+    sizeof(uint32_t));
+  if (block == NULL){
+    throw std::bad_alloc();
+  }
+  std::copy(rows.begin(), rows.end(), block);
+  std::copy(adj.begin(), adj.end(), block+size+1);
+  std::copy(slots.begin(), slots.end(), block+size+1+nslots);
+  std::copy(pairs.begin(), pairs.end(), block+size+1+2*nslots);
+  arena.reset(block, free);
+  place();
+  symmetric = (2*nbonds == nslots);
 }
 
-graph::~graph(void){
-/* Destructor for graph class
- * Makes sure memory for array of vertices is freed.
+void graph::restore(){
+/* Open every bond of the topology, undoing any previous call to percolate.
+ * The bfs state of the vertices is not affected.
  */
-  delete[] adj;
+  mask.assign((bonds()+63)/64, ~(uint64_t)0);
+  spread();
 }
 
-graph graph::operator=(const graph &G){
-/* Assignment operator
- * Assigns state of graph object to that of graph G. Returns self.
+void graph::spread(void){
+/* Copy the bond mask to the open slots of each vertex: slot s is open if bond
+ * eid[s] is. The bfs reads one byte per vertex rather than looking up each
+ * bond.
  */
-  delete[] adj;
-  size = G.size;
-  adj = new vertex[size];
-  vertex *u, *v;
-  uint n;
+  uint e;
+  open.assign(size, 0);
   for (uint i=0; i<size; i++){
-    // Copy the vertex manually
-    u = adj+i;
-    v = G.adj+i;
-    for (uint i=0; i<6; i++){
-      u->visited[i] = v->visited[i];
-      u->distance[i] = v->distance[i];
-      u->parent[i] = u+(v->parent[i]-v);
-      u->clusterid[i] = v->clusterid[i];
+    for (uint s=offsets[i]; s<offsets[i+1]; s++){
+      e = eid[s];
+      open[i] |= (mask[e/64]>>(e%64) & 1)<<(s-offsets[i]);
     }
-    n = v->adj.size();
-    for (uint j=0; j<n; j++){
-      u->add(u+(v->adj[j]-v)); // Retain relative positions
+  }
+}
+
+void graph::percolate(double p, uint seed, uint trial){
+/* Percolate the graph: open each bond independently with probability p.
+ * Bond e is open if number e of the counter-based stream for (seed, trial) is
+ * below the threshold for p. Each bond takes exactly one draw, and its state
+ * does not depend on the order bonds are visited in or on any other bond.
+ * Only the bond mask is written, so the same graph can be resampled at any p
+ * for every trial without being rebuilt. The mask is made 64 bonds at a time
+ * from a block of random words compared against the threshold.
+ * p     : probability of forming bonds.
+ * seed  : seed value for rng
+ * trial : trial number. Trials with the same seed are independent
+ */
+  philox r(seed, trial);
+  uint64_t t = philox::threshold(p);
+  uint32_t u[64], below = (uint32_t)t;
+  uint64_t bits;
+  if (t>>32 || t == 0){
+    mask.assign((bonds()+63)/64, t ? ~(uint64_t)0 : 0);
+    if (probe::on && probe::active && t == 0){
+      probe::active->closed += bonds();
     }
+    spread();
+    return;
   }
-  return *this;
+  mask.resize((bonds()+63)/64);
+  for (uint w=0; w<mask.size(); w++){
+    r.fill(w, u);
+    bits = 0;
+    for (uint k=0; k<64; k++){
+      bits |= (uint64_t)(u[k] < below)<<k;
+    }
+    mask[w] = bits;
+  }
+  if (probe::on && probe::active){
+    for (uint w=0; w<mask.size(); w++){
+      probe::active->closed += 64-__builtin_popcountll(mask[w]);
+    }
+    probe::active->closed -= 64*mask.size()-bonds();
+  }
+  spread();
 }
 
-void graph::reset(){
-/* Reset graph to original state. Just performs a reset on vertices. Cannot
- * change the adjacency since there is no default for a graph object.
+void graph::couple(uint seed, uint trial){
+/* Start a coupled sweep over p for one trial. Every bond is closed, and the
+ * bonds are sorted by their number of the stream for (seed, trial). Each call
+ * to raise then opens the bonds whose number is below the threshold for its
+ * p, so at each p the bond state is the same as percolate(p, seed, trial)
+ * would give, and raising p only ever adds bonds.
+ * seed  : seed value for rng
+ * trial : trial number
  */
-  vertex *v;
-  for (uint i=0; i<size; i++){
-    v=adj+i;
-    v->reset();
+  philox r(seed, trial);
+  uint32_t u[64];
+  order.resize(bonds());
+  for (uint w=0; 64*w<bonds(); w++){
+    r.fill(w, u);
+    for (uint e=64*w; e<std::min(64*w+64, bonds()); e++){
+      order[e] = (uint64_t)u[e%64]<<32 | e;
+    }
+  }
+  std::sort(order.begin(), order.end());
+  rank = 0;
+  mask.assign((bonds()+63)/64, 0);
+  open.assign(size, 0);
+  added.clear();
+}
+
+void graph::raise(double p){
+/* Open the bonds which are closed at the p of the last raise but open at p,
+ * and list their slots for repair. Takes the next bonds of order, so costs
+ * nothing for bonds that were already open. p must not be below that of the
+ * last raise since couple.
+ * p : probability of forming bonds
+ */
+  uint64_t t = philox::threshold(p);
+  uint e, a, b;
+  added.clear();
+  for (; rank<order.size() && (order[rank]>>32) < t; rank++){
+    e = (uint32_t)order[rank];
+    mask[e/64] |= (uint64_t)1<<(e%64);
+    a = ends[2*e];
+    b = ends[2*e+1];
+    for (uint k=0; k<2; k++){
+      for (uint s=offsets[a]; s<offsets[a+1]; s++){
+        if (eid[s] == e){
+          open[a] |= 1<<(s-offsets[a]);
+          added.push_back(a);
+          added.push_back(nbrs[s]);
+        }
+      }
+      if (a == b){
+        break; // Both slots of a loop are in the same row
+      }
+      std::swap(a, b);
+    }
+  }
+}
+
+void graph::repair(void){
+/* Update the distances in every direction after raise, without starting the
+ * searches again. Opening bonds can only shorten distances, and only starting
+ * from the slots just opened, so each direction is a search from the far end
+ * of every new slot that gives a shorter path, which goes no further than the
+ * vertices that get closer.
+ * Distances must be those of a complete traverse, or of an earlier repair, for
+ * the bonds open before the raise.
+ */
+  for (uint d=0; d<6; d++){
+    if (wide){
+      relax(dist32+d, false);
+    }
+    else if (!relax(dist16+d, false)){
+      // Ran out of room part way. Distances so far are all lengths of real
+      // paths, so it is enough to start again from every open slot
+      widen();
+      relax(dist32+d, true);
+    }
+  }
+}
+
+template<typename T>
+bool graph::relax(std::vector<T>* dist, bool all){
+/* Inner loop of repair. Each slot from u to v with d[u]+1 < d[v] lowers v,
+ * and v starts a search. The starting points are taken in order of distance
+ * together with the queue of the search, as in Dijkstra's algorithm with unit
+ * weights, so each vertex is settled the first time it is taken.
+ * dist : distances in the current direction
+ * all  : start from every open slot, rather than only those in added
+ * returns false if some distance would not fit in T
+ */
+  const T unvisited = (T)-1;
+  T* d = dist->data();
+  T next;
+  uint v, u, s, bits, head=0, k=0;
+  auto offer = [&](uint u, uint v) -> bool{
+    if (d[u] == unvisited){
+      return true;
+    }
+    if ((T)(d[u]+1) == unvisited){
+      return false;
+    }
+    if (d[u]+1 >= d[v]){
+      return true;
+    }
+    d[v] = d[u]+1;
+    sources.push_back(std::make_pair(d[v], v));
+    return true;
+  };
+  sources.clear();
+  if (all){
+    for (u=0; u<size; u++){
+      s = offsets[u];
+      for (bits=open[u]; bits; bits&=bits-1){
+        if (!offer(u, nbrs[s+__builtin_ctz(bits)])){
+          return false;
+        }
+      }
+    }
+  }
+  else{
+    for (uint i=0; i<added.size(); i+=2){
+      if (!offer(added[i], added[i+1])){
+        return false;
+      }
+    }
+  }
+  std::sort(sources.begin(), sources.end());
+  queue.clear();
+  while (k < sources.size() || head < queue.size()){
+    if (head == queue.size() ||
+        (k < sources.size() && sources[k].first <= d[queue[head]])){
+      v = sources[k].second;
+      if (d[v] != sources[k++].first){
+        continue; // Since lowered, and queued again
+      }
+    }
+    else{
+      v = queue[head++];
+    }
+    next = d[v]+1;
+    if (next == unvisited){
+      return false;
+    }
+    s = offsets[v];
+    for (bits=open[v]; bits; bits&=bits-1){
+      u = nbrs[s+__builtin_ctz(bits)];
+      if (next < d[u]){
+        d[u] = next;
+        queue.push_back(u);
+      }
+    }
   }
+  return true;
 }
 
-void graph::percolate(double p, uint seed){
-/* Percolate the graph: probabilistically remove edges.
- * p    : probability of forming bonds.
- * seed : seed value for rng
+void graph::percolate64(double p, uint seed, uint first){
+/* Percolate 64 copies of the graph at once, as trials first ... first+63 of
+ * seed. Bit k of open64[e] is set if bond e is open in trial first+k, drawn
+ * from the same counter-based stream as percolate, so each bit is exactly the
+ * bond state that percolate(p, seed, first+k) would give, and any trial of a
+ * block can be replayed and checked on its own. The topology and bond state
+ * used by bfs are not affected.
+ * p     : probability of forming bonds
+ * seed  : seed value for rng
+ * first : trial number of bit 0
  */
-  double q = 1-std::sqrt(p);
-  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
-  gsl_rng_set(r, seed);
+  uint64_t t = philox::threshold(p);
+  uint32_t u[64], below = (uint32_t)t;
+  uint n;
+  if (t>>32 || t == 0){
+    open64.assign(bonds(), t ? ~(uint64_t)0 : 0);
+    return;
+  }
+  open64.assign(bonds(), 0);
+  for (uint k=0; k<64; k++){
+    philox r(seed, first+k);
+    for (uint w=0; 64*w<bonds(); w++){
+      r.fill(w, u);
+      n = std::min(64u, bonds()-64*w);
+      for (uint j=0; j<n; j++){
+        open64[64*w+j] |= (uint64_t)(u[j] < below)<<k;
+      }
+    }
+  }
+}
+
+void graph::flood64(const std::vector<uint>& starts, uint64_t* reach){
+/* Reachability in the 64 trials of percolate64 at once. Bit t of reach[v] is
+ * set if v can be reached from one of the starting vertices in trial t. Each
+ * vertex is requeued whenever it gains bits, and passes them on through the
+ * open bonds with word-wide AND and OR.
+ * starts : starting vertices (reached in every trial)
+ * reach  : array of one word per vertex, overwritten
+ */
+  std::vector<bool> queued(size, false);
+  uint64_t gain;
+  uint v, u, s, head=0;
+  queue.clear();
   for (uint i=0; i<size; i++){
-    adj[i].percolate(q, r);
+    reach[i] = 0;
+  }
+  for (auto v : starts){
+    reach[v] = ~(uint64_t)0;
+    if (!queued[v]){
+      queued[v] = true;
+      queue.push_back(v);
+    }
+  }
+  while (head < queue.size()){
+    v = queue[head++];
+    queued[v] = false;
+    for (s=offsets[v]; s<offsets[v+1]; s++){
+      u = nbrs[s];
+      gain = reach[v] & open64[eid[s]] & ~reach[u];
+      if (gain){
+        reach[u] |= gain;
+        if (!queued[u]){
+          queued[u] = true;
+          queue.push_back(u);
+        }
+      }
+    }
+    if (head == queue.size() || head > size){
+      // Compact the queue so that it never outgrows the graph
+      queue.erase(queue.begin(), queue.begin()+head);
+      head = 0;
+    }
   }
-  gsl_rng_free(r);
 }
 
-void graph::bfs(uint start, uint dir, uint id){
+void graph::bfs(uint start, uint dir){
 /* Breadth-first search over graph, starting from the vertex with index start
- * and labelling in direction dir (optionally tagging with number id)
+ * and labelling in direction dir
  * start : index of starting vertex
- * dir   : direction (0,1,...,5) This affects which values to update in
- *         clusterid, visited and distance. Naive support for directionality
- * id    : id to use for this connected component
+ * dir   : direction (0,1,...,5) This affects which distances are updated.
+ *         Naive support for directionality
  */
-  vertex *v=adj+start;
-  std::queue<vertex*> Q;
-  if (v->visited[dir])
+  if (distance(dir, start) != (uint)-1)
     return; // Already visited on a previous bfs
-  v->parent[dir] = v;
-  v->distance[dir] = 0;
-  v->visited[dir] = true;
-  v->clusterid[dir]=id;
-  Q.push(v);
-  bfs(&Q, dir, id);
-}
-
-void graph::bfs(std::queue<vertex*> *Q, uint dir, uint id){
-/* Breadth-first search over graph, starting from queued vertices
- * and labelling in direction dir (optionally tagging with number id)
- * Q    : Initially queued vertices
- * dir  : direction (0,1,...,5) This affects which values to update in
- *        clusterid, visited and distance. Naive support for directionality
- * id   : id to use for this connected component
- */
-  vertex *v, *u;
-  while (!Q->empty()){
-    v = Q->front();
-    Q->pop();
-    for (uint i=0; i<v->adj.size(); i++){
-      u = v->adj[i];
-      if (!u->visited[dir]){
-        u->parent[dir] = v;
-        u->visited[dir] = true;
-        u->distance[dir] = v->distance[dir]+1;
-        u->clusterid[dir]=id;
-        Q->push(u);
+  bfs(std::vector<uint>(1, start), dir);
+}
+
+void graph::bfs(const std::vector<uint>& starts, uint dir){
+/* Breadth-first search over graph, starting from a set of vertices which are
+ * all given distance zero, and labelling in direction dir
+ * starts : indices of starting vertices
+ * dir    : direction (0,1,...,5) This affects which distances are updated.
+ *          Naive support for directionality
+ */
+  uint head=0;
+  queue.clear();
+  for (auto v : starts){
+    if (wide){
+      dist32[dir][v] = 0;
+    }
+    else{
+      dist16[dir][v] = 0;
+    }
+    queue.push_back(v);
+  }
+  if (wide || !search(dist16+dir, &head)){
+    if (!wide){
+      widen(); // Ran out of room. Carry on from where the search stopped
+    }
+    search(dist32+dir, &head);
+  }
+  if (probe::on && probe::active){
+    probe::active->enqueued[dir] += queue.size();
+  }
+}
+
+void graph::bfs(const std::vector<uint>* starts){
+/* Breadth-first search in all six directions together. The six distances of a
+ * vertex are packed into one vector, and the search advances level by level:
+ * each vertex on the frontier offers its distances plus one to all of its
+ * neighbours, which keep the lane-wise minimum. So each edge is read once per
+ * level it is relaxed on, rather than once per direction.
+ * On level l a vertex only offers the lanes which it got on level l.
+ * A vertex joins the next frontier when any of its lanes improves. Since all
+ * lanes advance in step, a lane is final as soon as it is set, exactly as in
+ * six separate searches.
+ * If the distances outgrow 16 bits, falls back to six separate searches.
+ * starts : starting vertices in each of the six directions
+ */
+  const lanes unvisited = {0xFFFF,0xFFFF,0xFFFF,0xFFFF,
+                           0xFFFF,0xFFFF,0xFFFF,0xFFFF};
+  const lanes zero = {};
+  lanes reached, offer, old, now;
+  uint16_t level=0;
+  uint u, s, bits;
+  packed.assign(size, unvisited);
+  queue.clear();
+  for (uint d=0; d<6; d++){
+    for (auto v : starts[d]){
+      if (!any((lanes)(packed[v] == 0))){
+        queue.push_back(v);
+      }
+      packed[v][d] = 0;
+    }
+  }
+  while (!queue.empty()){
+    if (level+1 == 0xFFFF){
+      // Out of room. Do it the slow way
+      reset();
+      for (uint d=0; d<6; d++){
+        bfs(starts[d], d);
+      }
+      return;
+    }
+    reached = zero+(uint16_t)(level+1);
+    frontier.clear();
+    for (auto v : queue){
+      // Only lanes set on the last level are offered. Lanes of v set on this
+      // level are not final yet and must wait their turn
+      offer = reached | ~(lanes)(packed[v] == level);
+      s = offsets[v];
+      for (bits=open[v]; bits; bits&=bits-1){
+        u = nbrs[s+__builtin_ctz(bits)];
+        old = packed[u];
+        now = old < offer ? old : offer;
+        if (any((lanes)(now != old))){
+          if (!any((lanes)(old == reached))){
+            frontier.push_back(u);
+          }
+          packed[u] = now;
+        }
+      }
+    }
+    queue.swap(frontier);
+    level++;
+  }
+  // Unpack into the per-direction arrays
+  for (uint i=0; i<size; i++){
+    for (uint d=0; d<6; d++){
+      if (wide){
+        dist32[d][i] = packed[i][d]==0xFFFF ? (uint32_t)-1 : packed[i][d];
+      }
+      else{
+        dist16[d][i] = packed[i][d];
+      }
+    }
+  }
+}
+
+uint graph::meet(const std::vector<uint>& from, const std::vector<uint>& to,
+    bool length){
+/* Shortest path between two sets of vertices, by bfs from both at once. Each
+ * step takes a whole level of whichever side has the smaller frontier, and
+ * stops at the end of the first level that reaches a vertex of the other
+ * side, which is as soon as the shortest path is known. Only the two balls
+ * around the sets are visited, rather than everything reachable from one.
+ * Searching from to needs every bond to be visible from both ends, so if the
+ * graph is not symmetric (as found by build) only from is expanded, and the
+ * path found is the shortest one leading from from to to.
+ * from   : vertices at one end
+ * to     : vertices at the other end
+ * length : if false, stop at the first path found, whatever its length
+ * returns the number of bonds on the shortest path (0 if the sets share a
+ * vertex), or (uint)(-1) if there is none. If length is false, returns 0
+ * if there is a path
+ */
+  const uint32_t far=(uint32_t)1<<31, unvisited=(uint32_t)-1;
+  std::vector<uint> ahead;
+  std::vector<uint>* cur;
+  uint32_t side, reach[2]={0, 0};
+  uint u, s, bits, best=(uint)-1;
+  sides.assign(size, unvisited);
+  queue.clear();
+  frontier.clear();
+  for (auto v : to){
+    sides[v] = far;
+    frontier.push_back(v);
+  }
+  for (auto v : from){
+    if (sides[v] == far){
+      return 0;
+    }
+    sides[v] = 0;
+    queue.push_back(v);
+  }
+  while (!queue.empty() && !frontier.empty()){
+    // Expand from (side 0) or to (side far)
+    side = (symmetric && frontier.size() < queue.size()) ? far : 0;
+    cur = side ? &frontier : &queue;
+    ahead.clear();
+    for (auto v : *cur){
+      s = offsets[v];
+      for (bits=open[v]; bits; bits&=bits-1){
+        u = nbrs[s+__builtin_ctz(bits)];
+        if (sides[u] == unvisited){
+          sides[u] = side | (reach[side!=0]+1);
+          ahead.push_back(u);
+        }
+        else if ((sides[u] & far) != side){
+          if (!length){
+            return 0;
+          }
+          best = std::min(best, reach[side!=0]+1+(sides[u] & ~far));
+        }
+      }
+    }
+    if (best != (uint)-1){
+      return best;
+    }
+    cur->swap(ahead);
+    reach[side!=0]++;
+  }
+  return (uint)-1;
+}
+
+template<typename T>
+bool graph::search(std::vector<T>* dist, uint* head){
+/* Inner loop of bfs. Takes vertices from the queue, starting at position head,
+ * one level at a time until it is empty.
+ * Levels are expanded top-down, each frontier vertex visiting its unvisited
+ * neighbours, while the frontier is small compared with what is left. Once it
+ * is over half the size, most of its bonds lead to vertices which are already
+ * visited, so levels are done bottom-up instead: each vertex still unvisited
+ * looks for any neighbour in the frontier (kept as a bitmap), and stops at the
+ * first. This goes back to top-down once the frontier is under a quarter of
+ * what is left. Bottom-up needs every bond to be visible from both ends, so is
+ * only used on symmetric graphs (see build).
+ * On a lattice the frontier is a thin sheet and the switch only happens near
+ * the end of the search. It pays off on graphs with short paths, where the
+ * frontier can take in most of the graph at once.
+ * dist : distances in the current direction
+ * head : position of the front of the queue. Updated as vertices are taken
+ * returns false, leaving the queue as it is, if the next level would need a
+ * distance that does not fit in T
+ */
+  const uint alpha=2, beta=4;   // Switching thresholds (see above)
+  const T unvisited = (T)-1;
+  T* d = dist->data();
+  T next;
+  uint v, u, s, bits, end, k, kept, nrest=0;
+  bool up=false;                // Whether the last level was done bottom-up
+  bool listed=false;            // Whether rest holds the unvisited vertices
+  while (*head < queue.size()){
+    next = d[queue[*head]]+1;
+    if (next == unvisited){
+      return false;
+    }
+    end = queue.size();         // This level is queue[*head] ... queue[end-1]
+    if (probe::on && probe::active){
+      probe::active->peak = std::max(probe::active->peak, (uint64_t)end-*head);
+    }
+    if (!up && symmetric && (uint64_t)alpha*(end-*head) > size-end){
+      up = true;
+      if (!listed){
+        // Unvisited vertices, shrunk as they are reached
+        rest.clear();
+        for (u=0; u<size; u++){
+          if (d[u] == unvisited){
+            rest.push_back(u);
+          }
+        }
+        nrest = rest.size();
+        listed = true;
+      }
+    }
+    else if (up && (uint64_t)beta*(end-*head) < nrest){
+      up = false;
+    }
+    if (up){
+      front.assign((size+63)/64, 0);
+      for (; *head<end; (*head)++){
+        v = queue[*head];
+        front[v/64] |= (uint64_t)1<<(v%64);
+      }
+      for (k=0, kept=0; k<nrest; k++){
+        u = rest[k];
+        if (d[u] != unvisited){
+          continue;             // Reached by a top-down level since
+        }
+        s = offsets[u];
+        for (bits=open[u]; bits; bits&=bits-1){
+          v = nbrs[s+__builtin_ctz(bits)];
+          if (front[v/64]>>(v%64) & 1){
+            break;
+          }
+        }
+        if (bits){
+          d[u] = next;
+          queue.push_back(u);
+        }
+        else{
+          rest[kept++] = u;
+        }
+      }
+      nrest = kept;
+    }
+    else{
+      for (; *head<end; (*head)++){
+        v = queue[*head];
+        s = offsets[v];
+        for (bits=open[v]; bits; bits&=bits-1){
+          u = nbrs[s+__builtin_ctz(bits)];
+          if (d[u] == unvisited){
+            d[u] = next;
+            queue.push_back(u);
+          }
+        }
       }
     }
   }
+  return true;
 }
 
 void graph::print(void) const{
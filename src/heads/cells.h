@@ -0,0 +1,195 @@
+// cells.h
+// Header file for compile-time unit cells
+
+#ifndef h_cells
+#define h_cells
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "lattice.h"
+
+namespace cells{
+/* Unit cells as compile-time constants. Each cell is a struct with
+ *   size    : number of vertices in the unit cell
+ *   degree  : number of connections out of every vertex
+ *   adj     : the connections, degree of them per vertex, as 4-vectors in the
+ *             same form as lattice_t::add
+ *   startx, ..., endz : starting (finishing) vertices for crossing clusters
+ * These are the only description of the built-in lattices: the lattices::
+ * generators are built from them (see make), and kernels can be templated on
+ * them so that offsets, degrees and faces are known to the compiler.
+ */
+  struct link{
+    int h;  // Internal to unit cell (absolute)
+    int i;  // In x direction (relative)
+    int j;  // In y direction (relative)
+    int k;  // In z direction (relative)
+  };
+
+  struct cubic{
+  /* Unit cell for cubic lattice
+   */
+    static const char* label(void){return "cubic";};
+    static constexpr uint size = 1;
+    static constexpr uint degree = 6;
+    static constexpr link adj[size*degree] = {
+      {0,-1,0,0}, {0,1,0,0}, {0,0,-1,0}, {0,0,1,0}, {0,0,0,-1}, {0,0,0,1}};
+    static constexpr uint startx[] = {0};
+    static constexpr uint starty[] = {0};
+    static constexpr uint startz[] = {0};
+    static constexpr uint endx[] = {0};
+    static constexpr uint endy[] = {0};
+    static constexpr uint endz[] = {0};
+  };
+
+  struct raussendorf{
+  /* Unit cell for raussendorf lattice
+   */
+    static const char* label(void){return "raussendorf";};
+    static constexpr uint size = 6;
+    static constexpr uint degree = 4;
+    static constexpr link adj[size*degree] = {
+      {1,0,0,0}, {5,0,0,0}, {1,0,-1,0}, {5,0,0,-1},  // 0
+      {2,0,0,0}, {0,0,0,0}, {2,-1,0,0}, {0,0,1,0},  // 1
+      {3,0,0,0}, {1,0,0,0}, {3,0,0,-1}, {1,1,0,0},  // 2
+      {4,0,0,0}, {2,0,0,0}, {4,0,1,0}, {2,0,0,1},  // 3
+      {5,0,0,0}, {3,0,0,0}, {5,1,0,0}, {3,0,-1,0},  // 4
+      {0,0,0,0}, {4,0,0,0}, {0,0,0,1}, {4,-1,0,0}   // 5
+    };
+    static constexpr uint startx[] = {1,5};
+    static constexpr uint starty[] = {0,4};
+    static constexpr uint startz[] = {0,2};
+    static constexpr uint endx[] = {2,4};
+    static constexpr uint endy[] = {1,3};
+    static constexpr uint endz[] = {3,5};
+  };
+
+  struct diamond{
+  /* Unit cell for diamond lattice
+   */
+    static const char* label(void){return "diamond";};
+    static constexpr uint size = 8;
+    static constexpr uint degree = 4;
+    static constexpr link adj[size*degree] = {
+      {1,0,0,0}, {5,-1,1,0}, {6,-1,0,1}, {7,0,1,1},  // 0
+      {0,0,0,0}, {2,0,0,0}, {3,0,0,0}, {4,0,0,0},  // 1
+      {1,0,0,0}, {5,0,0,0}, {6,0,0,1}, {7,0,0,1},  // 2
+      {1,0,0,0}, {5,0,1,0}, {6,0,0,0}, {7,0,1,0},  // 3
+      {1,0,0,0}, {5,-1,0,0}, {6,-1,0,0}, {7,0,0,0},  // 4
+      {0,1,-1,0}, {2,0,0,0}, {3,0,-1,0}, {4,1,0,0},  // 5
+      {0,1,0,-1}, {2,0,0,-1}, {3,0,0,0}, {4,1,0,0},  // 6
+      {0,0,-1,-1}, {2,0,0,-1}, {3,0,-1,0}, {4,0,0,0}   // 7
+    };
+    static constexpr uint startx[] = {0,4};
+    static constexpr uint starty[] = {5,7};
+    static constexpr uint startz[] = {6,7};
+    static constexpr uint endx[] = {5,6};
+    static constexpr uint endy[] = {0,3};
+    static constexpr uint endz[] = {0,2};
+  };
+
+  struct diamond_grid{
+  /* Alternative unit cell for diamond lattice. Fits on square grid. Courtesy of
+   * Mercedes
+   */
+    static const char* label(void){return "diamond (grid)";};
+    static constexpr uint size = 8;
+    static constexpr uint degree = 4;
+    static constexpr link adj[size*degree] = {
+      {1,0,0,0}, {5,0,0,0}, {5,-1,0,0}, {6,0,-1,0},  // 0
+      {0,0,0,0}, {2,0,0,0}, {2,0,0,0}, {7,-1,0,0},  // 1
+      {1,0,0,0}, {3,0,0,0}, {3,-1,0,0}, {6,0,0,1},  // 2
+      {2,0,0,0}, {4,0,0,0}, {2,1,0,0}, {7,0,1,0},  // 3
+      {3,0,0,0}, {5,0,0,0}, {6,0,0,0}, {6,1,0,0},  // 4
+      {0,0,0,0}, {4,0,0,0}, {0,1,0,0}, {7,0,0,-1},  // 5
+      {4,0,0,0}, {0,0,1,0}, {2,0,0,-1}, {4,-1,0,0},  // 6
+      {1,0,0,0}, {1,1,0,0}, {3,0,-1,0}, {5,0,0,1}   // 7
+    };
+    static constexpr uint startx[] = {0,1,2,6};
+    static constexpr uint starty[] = {0,7};
+    static constexpr uint startz[] = {5,6};
+    static constexpr uint endx[] = {3,4,5,7};
+    static constexpr uint endy[] = {3,6};
+    static constexpr uint endz[] = {2,7};
+  };
+
+  template<class C>
+  struct fixed{
+  /* Access to cell C through the same methods as a cell only known at
+   * runtime, so that kernels can be written once and templated on either.
+   * Everything here folds to a constant.
+   */
+    uint size(void) const {return C::size;};
+    uint degree(uint) const {return C::degree;};
+    const link& adj(uint w, uint i) const {return C::adj[w*C::degree+i];};
+  };
+
+  template<class C> lattice_t make(void);
+                          // Build the runtime description of unit cell C
+  template<class C> bool same(const lattice_t& D);
+                          // Whether D describes exactly unit cell C
+  uint lookup(const lattice_t& D);
+                          // Index of the compile-time cell that D is, in the
+                          // order cubic, raussendorf, diamond, diamond_grid,
+                          // counting from 1. 0 if there is none
+};
+
+template<class C>
+lattice_t cells::make(void){
+/* Build the runtime description of unit cell C, for the lattice class and
+ * anything else that does not need the cell at compile time
+ */
+  lattice_t D(C::size, C::label());
+  for (uint w=0; w<C::size; w++){
+    for (uint i=0; i<C::degree; i++){
+      const link& L = C::adj[w*C::degree+i];
+      D.add(w, L.h, L.i, L.j, L.k);
+    }
+  }
+  D.startx.assign(C::startx, C::startx+sizeof(C::startx)/sizeof(uint));
+  D.starty.assign(C::starty, C::starty+sizeof(C::starty)/sizeof(uint));
+  D.startz.assign(C::startz, C::startz+sizeof(C::startz)/sizeof(uint));
+  D.endx.assign(C::endx, C::endx+sizeof(C::endx)/sizeof(uint));
+  D.endy.assign(C::endy, C::endy+sizeof(C::endy)/sizeof(uint));
+  D.endz.assign(C::endz, C::endz+sizeof(C::endz)/sizeof(uint));
+  return D;
+}
+
+template<class C>
+bool cells::same(const lattice_t& D){
+/* Whether D is unit cell C in every detail a kernel compiled for C relies
+ * on: the number of vertices, every connection in order, and the faces.
+ * The label alone is not enough, as nothing stops a cell built at runtime
+ * from reusing the name of a built-in one
+ * D : runtime unit cell
+ */
+  auto face = [](const std::vector<uint>& v, const uint* a, size_t n){
+    return v.size() == n && std::equal(v.begin(), v.end(), a);
+  };
+  if (D.label != C::label() || D.size != C::size){
+    return false;
+  }
+  for (uint w=0; w<C::size; w++){
+    if (D.adjacency[w].size() != C::degree){
+      return false;
+    }
+    for (uint i=0; i<C::degree; i++){
+      const link& L = C::adj[w*C::degree+i];
+      if (D.adjacency[w][i].h != L.h || D.adjacency[w][i].i != L.i ||
+          D.adjacency[w][i].j != L.j || D.adjacency[w][i].k != L.k){
+        return false;
+      }
+    }
+  }
+  return face(D.startx, C::startx, sizeof(C::startx)/sizeof(uint)) &&
+    face(D.starty, C::starty, sizeof(C::starty)/sizeof(uint)) &&
+    face(D.startz, C::startz, sizeof(C::startz)/sizeof(uint)) &&
+    face(D.endx, C::endx, sizeof(C::endx)/sizeof(uint)) &&
+    face(D.endy, C::endy, sizeof(C::endy)/sizeof(uint)) &&
+    face(D.endz, C::endz, sizeof(C::endz)/sizeof(uint));
+}
+
+#endif
@@ -5,64 +5,148 @@
 #define h_graph
 
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <stdexcept>
+#include <new>
 #include <vector>
+#include <memory>
+#include <algorithm>
 #include <cmath>
-#include <queue>
 
-#include <gsl/gsl_rng.h>
+#include "philox.h"
+#include "probe.h"
 
 class graph{
 /* graph class
- * Just an array of vertex (subclass) objects with no information about e.g.
- * lattice geometry. Derived class lattice (seperate header file) provides
- * this functionality
+ * Just a set of vertices and the edges between them, with no information
+ * about e.g. lattice geometry. Derived class lattice (seperate header file)
+ * provides this functionality
  */
   private:
+    typedef uint16_t lanes __attribute__((vector_size(16)));
+                                  // Distances of one vertex in all six
+                                  // directions (two spare lanes), packed so
+                                  // they can be updated with vector operations
+    static bool any(lanes m)
+      {typedef uint64_t halves __attribute__((vector_size(16)));
+       halves h = (halves)m; return (h[0] | h[1]) != 0;};
+                                  // Whether any lane of m is nonzero
+    std::vector<uint> queue;      // Work queue for bfs, reused between calls
+    std::vector<uint> frontier;   // Second queue for bfs in all directions
+    std::vector<lanes> packed;    // Distances for bfs in all directions
+    std::vector<uint64_t> front;  // Bitmap of the frontier, for bottom-up bfs
+    std::vector<uint> rest;       // Unvisited vertices, for bottom-up bfs
+    std::vector<uint32_t> sides;  // Distances for meet. The top bit is set
+                                  // for vertices reached from the far side
+    template<typename T> bool search(std::vector<T>* dist, uint* head);
+                                  // Inner loop of bfs for distances of type T
+    std::vector<std::pair<uint, uint> > sources;
+                                  // Vertices to start a repair from, and
+                                  // their distances
+    template<typename T> bool relax(std::vector<T>* dist, bool all);
+                                  // Inner loop of repair for distances of
+                                  // type T
+    void widen(void);             // Switch distances from 16 to 32 bits
   protected:
     uint size;
-    class vertex{
-    /* vertex class
-     * Stores a vector of pointers to adjacent vertices. Supports attributes
-     * and methods to genrate the lattice and perform percolation and bfs
-     * algorithms.
-     */
-    private:
-      public:
-        vertex* parent[6];        // Parent vertex in bfs. Allows directions
-        uint clusterid[6];        // Optional cluster id for bfs
-        bool visited[6];          // Track whether vertex has been visited
-        uint distance[6];         // Distance from start of bfs
-        std::vector<vertex*> adj; // Vector of (pointers to) adjacent vertices
-        // Constructors
-        vertex(void);
-        // Access methods
-        void reset(void);
-          // Reset vertex to its default state
-        void add(vertex* v){adj.push_back(v);};
-          // Add a connection to the vertex
-        void percolate(double q, gsl_rng* r);
-          // Delete edges probabilistically with probability q
-    };
+    // Compressed sparse row topology. Fixed once the graph is built; the
+    // neighbours of vertex i are nbrs[offsets[i]] ... nbrs[offsets[i+1]-1].
+    // All four arrays live in one block, the arena, and refer to each other
+    // only by index. The arena is never written once built, so copies of a
+    // graph share it, and it is freed along with the last of them
+    std::shared_ptr<const uint32_t> arena;
+                                  // offsets, nbrs, eid then ends
+    uint nslots;                  // Number of slots of nbrs (and eid)
+    uint nbonds;                  // Number of undirected bonds
+    const uint32_t* offsets;      // Start of each row in nbrs (size+1 entries)
+    const uint32_t* nbrs;         // Indices of adjacent vertices, row by row
+    const uint32_t* eid;          // Bond number of each slot of nbrs
+    const uint32_t* ends;         // Endpoints of each undirected bond, in pairs
+    void build(const std::vector<uint32_t>& rows,
+      const std::vector<uint32_t>& adj);
+                                  // Lay out the topology in a new arena and
+                                  // number its bonds
+    void place(void);             // Point offsets ... ends into the arena
+    void swap(graph& G) noexcept; // Exchange everything with G
+    bool symmetric;               // Whether every slot is paired with one
+                                  // leading back, so that bonds can be
+                                  // followed from either end
+    // Bond state. The topology is never modified; percolation only sets
+    // which bonds are open, and the bfs skips the closed ones
+    std::vector<uint64_t> mask;   // Bit e%64 of word e/64 set if bond e open
+    std::vector<uint8_t> open;    // Open slots of each vertex, bit k for slot
+                                  // offsets[i]+k (so at most 8 slots per row)
+    void spread(void);            // Set open from mask
+    std::vector<uint64_t> order;  // Bonds of the trial being raised (see
+                                  // couple) in the order they open, each as
+                                  // its number of the stream (high 32 bits)
+                                  // and bond number (low 32 bits)
+    uint rank;                    // Number of bonds of order open so far
+    std::vector<uint32_t> added;  // Slots opened by the last raise, as pairs
+                                  // of vertices (from, to)
+    std::vector<uint64_t> open64; // Bond state of 64 trials at once, one bit
+                                  // per trial (see percolate64)
+    // Bfs state. One array per direction, indexed by vertex. Distances are
+    // kept in 16 bits until a bfs runs out of room, then in 32 bits. The
+    // largest value of the type marks a vertex that has not been visited
+    bool wide;                    // Whether distances are in dist32
+    std::vector<uint16_t> dist16[6];
+    std::vector<uint32_t> dist32[6];
   public:
-    vertex* adj;
 // Constructors
-    graph(void);            // Create graph with zero vertices
+    graph(void) noexcept;   // Create graph with zero vertices
     graph(uint n);          // Create graph with n vertices, no adjacency
-    graph(const graph& G);  // Copy constructor
+    graph(const graph& G);  // Copy constructor. Shares the topology of G
+    graph(graph&& G) noexcept;
+                            // Move constructor. Leaves G empty
 // Destructor
-    ~graph(void);           // Destructor. Free memory from array adj
+    ~graph(void);           // Destructor
 // Overloads
-    graph operator=(const graph& G);
+    graph& operator=(const graph& G);
       // Assignment operator
+    graph& operator=(graph&& G) noexcept;
+      // Move assignment operator
     void reset();           // Reset all vertices to default state
-    void percolate(double p, uint seed=314);
-      // Probabilistically delete edges.
-    void bfs(uint start, uint dir, uint id=0);
-    void bfs(std::queue<vertex*>* Q, uint dir, uint id=0);
+    void restore();         // Open every bond
+    void percolate(double p, uint seed=314, uint trial=0);
+      // Open each bond with probability p, drawing bond states for trial
+      // number trial of seed
+    void couple(uint seed=314, uint trial=0);
+      // Close every bond, ready to raise p through the values of one trial
+    void raise(double p);
+      // Open the further bonds that are open at p in the trial being raised
+    void repair(void);
+      // Bring the distances up to date with the bonds opened by raise
+    void percolate64(double p, uint seed=314, uint first=0);
+      // Open bonds in trials first ... first+63 at once, one bit per trial
+    void flood64(const std::vector<uint>& starts, uint64_t* reach);
+      // Find the vertices reachable from starts in each of the 64 trials
+    void bfs(uint start, uint dir);
+    void bfs(const std::vector<uint>& starts, uint dir);
       // Breadth first search routines starting with a single vertex or set of
-      // queued vertices
+      // vertices
+    void bfs(const std::vector<uint>* starts);
+      // Breadth first search in all six directions at once, direction d
+      // starting from the vertices starts[d]
+    uint meet(const std::vector<uint>& from, const std::vector<uint>& to,
+      bool length=true);
+      // Length of the shortest open path between two sets of vertices, by
+      // breadth first search from both ends, stopping as soon as they meet
 // Access methods
+    uint vertices(void) const {return size;};
+                            // Number of vertices
+    uint bonds(void) const {return nbonds;};
+                            // Number of undirected bonds in the topology
+    uint32_t end(uint e, uint k) const {return ends[2*e+k];};
+                            // Endpoint k (0 or 1) of bond e
+    uint distance(uint dir, uint v) const
+      {return wide ? dist32[dir][v] :
+        (dist16[dir][v]==(uint16_t)-1 ? (uint)-1 : dist16[dir][v]);};
+                            // Distance of v from the start of the bfs in
+                            // direction dir. (uint)(-1) if not visited
     void print(void) const; // Print summary of graph to cout
 };
 
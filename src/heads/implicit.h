@@ -0,0 +1,160 @@
+// implicit.h
+// Header file for implicit class
+
+#ifndef h_implicit
+#define h_implicit
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include "lattice.h"
+#include "philox.h"
+#include "cells.h"
+
+class implicit{
+/* implicit lattice class.
+ * Same lattices as the lattice class, but with no stored adjacency. The
+ * neighbours of a vertex are worked out when needed from the unit cell, and
+ * the only per-vertex storage is one byte saying which of its (at most 8)
+ * bonds are open. Vertex indices are 64 bits, so lattices can have more than
+ * 2^32 vertices.
+ */
+  protected:
+    uint dimx;                    // Dimensions of lattice (number of unit
+    uint dimy;                    // cells in the x, y and z directions)
+    uint dimz;
+    uint64_t size;                // Number of vertices
+    lattice_t type;               // Unit cell
+    uint ncell;                   // Number of vertices in the unit cell
+    // Unit cell connections, slot i of cell vertex w at w*8+i
+    std::vector<uint> degree;     // Number of slots of each cell vertex
+    std::vector<cells::link> links;
+                                  // Cell vertex and offset at the other end
+    std::vector<int> reverse;     // Slot at the other end leading back (-1 if
+                                  // the unit cell has no such slot)
+    std::vector<uint8_t> open;    // Open bonds of each vertex, bit i for slot i
+    std::vector<uint32_t> distance[6];
+                                  // Distance from the start of the bfs in
+                                  // each direction. Only allocated by traverse
+    uint kernel;                  // Compiled-in cell to use (cells::lookup),
+                                  // or 0 to use the tables above
+    struct runtime{               // Unit cell from the tables above, with
+      const implicit& I;          // the same methods as cells::fixed
+      uint size(void) const {return I.ncell;};
+      uint degree(uint w) const {return I.degree[w];};
+      const cells::link& adj(uint w, uint i) const {return I.links[8*w+i];};
+    };
+    std::deque<uint64_t> queue;   // Work queue for bfs. A deque, so memory
+                                  // is only held for the current frontier
+    uint64_t fromCoord(uint h, uint i, uint j, uint k) const
+      {return h+ncell*(i+(uint64_t)dimx*(j+(uint64_t)dimy*k));};
+                                  // Convert 4D coordinate to 1D index
+    template<class C> void toCoord(const C& cell, uint64_t n, uint* c) const;
+                                  // Convert 1D index to 4D coordinate
+    template<class C>
+    bool neighbour(const C& cell, const uint* c, uint i, uint64_t* u) const;
+                                  // Find the vertex at the end of slot i
+    template<class C> void percolate(const C& cell, uint64_t t, philox* r);
+                                  // Open bonds, for unit cell C
+    template<typename F> void face(uint d, F f) const;
+                                  // Call f on each starting vertex of the bfs
+                                  // in direction d
+    template<class C, typename F> void search(const C& cell, F visit);
+                                  // Breadth first search from the queue
+    template<typename F> void search(F visit);
+                                  // Same, with the kernel for this lattice
+  public:
+    implicit(const lattice_t& D, uint L, uint M, uint N, bool store=true);
+                                  // Construct a LxMxN lattice with unit cell D
+    void percolate(double p, uint seed=314, uint trial=0);
+                                  // Open each bond with probability p, for
+                                  // trial number trial of seed
+    void traverse();              // Perform bfs in all 6 directions
+    std::vector<uint> findCrossings();
+                                  // Find the smallest crossing clusters
+    std::vector<bool> findSpanning();
+                                  // Find which crossing clusters exist, using
+                                  // one bit per vertex per direction
+    // Access methods
+    uint64_t vertices(void) const {return size;};
+                                  // Number of vertices
+    bool isOpen(uint64_t n, uint i) const {return open[n]>>i & 1;};
+                                  // Whether slot i of vertex n is open
+    std::string label() const {return type.label;};
+                                  // Text label of the unit cell
+    void print(void);             // Print summary of lattice to cout
+};
+
+// Templates shared with derived classes
+
+template<class C>
+void implicit::toCoord(const C& cell, uint64_t n, uint* c) const{
+/* Convert 1D index to 4D coordinate
+ * cell : unit cell, cells::fixed or runtime
+ * n    : index of vertex
+ * c    : set to the cell vertex and the x, y and z cell coordinates
+ */
+  c[0] = n%cell.size();
+  n /= cell.size();
+  c[1] = n%dimx;
+  n /= dimx;
+  c[2] = n%dimy;
+  c[3] = n/dimy;
+}
+
+template<class C>
+bool implicit::neighbour(const C& cell, const uint* c, uint i, uint64_t* u)
+  const{
+/* Find the vertex at the other end of slot i
+ * cell : unit cell, cells::fixed or runtime
+ * c    : 4D coordinate of the vertex
+ * i    : slot, less than the degree of cell vertex c[0]
+ * u    : set to the index of the neighbour
+ * returns false if the neighbour would be outside the lattice
+ */
+  const cells::link& l = cell.adj(c[0], i);
+  int x = c[1]+l.i, y = c[2]+l.j, z = c[3]+l.k;
+  if (x < 0 || x >= (int)dimx || y < 0 || y >= (int)dimy ||
+      z < 0 || z >= (int)dimz){
+    return false;
+  }
+  *u = l.h+cell.size()*(x+(uint64_t)dimx*(y+(uint64_t)dimy*z));
+  return true;
+}
+
+template<typename F>
+void implicit::face(uint d, F f) const{
+/* Call f on each starting vertex of the bfs in direction d: the start faces
+ * for d = 0,1,2 (+x,+y,+z) and the end faces for d = 3,4,5 (-x,-y,-z)
+ * d : direction
+ * f : function called with the index of each vertex
+ */
+  const std::vector<uint>* cells[6] = {&type.startx, &type.starty,
+    &type.startz, &type.endx, &type.endy, &type.endz};
+  uint a, b;
+  if (size == 0){
+    return;
+  }
+  for (a=0; a<(d%3==2 ? dimy : dimz); a++){
+    for (b=0; b<(d%3==0 ? dimy : dimx); b++){
+      for (auto h : *cells[d]){
+        switch (d){
+          case 0: f(fromCoord(h,0,b,a)); break;
+          case 1: f(fromCoord(h,b,0,a)); break;
+          case 2: f(fromCoord(h,b,a,0)); break;
+          case 3: f(fromCoord(h,dimx-1,b,a)); break;
+          case 4: f(fromCoord(h,b,dimy-1,a)); break;
+          case 5: f(fromCoord(h,b,a,dimz-1)); break;
+        }
+      }
+    }
+  }
+}
+
+#endif
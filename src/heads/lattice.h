@@ -7,8 +7,10 @@
 #include <iostream>
 #include <cstdlib>
 #include <vector>
+#include <algorithm>
 
 #include "graph.h"
+#include "unionfind.h"
 
 class lattice_t{
 /* lattice type class.
@@ -42,11 +44,15 @@ class lattice_t{
     lattice_t(void);      // Empty constructor
     lattice_t(const lattice_t& D);
                           // Copy constructor
+    lattice_t(lattice_t&& D) noexcept;
+                          // Move constructor
     lattice_t(uint n, std::string s);
                           // New constructor
     ~lattice_t(void);     // Destructor
-    lattice_t operator=(const lattice_t& D);
+    lattice_t& operator=(const lattice_t& D);
                           // Assignment operator
+    lattice_t& operator=(lattice_t&& D) noexcept;
+                          // Move assignment operator
     // Access methods
     void add(uint start, int h, int i, int j, int k);
                           // Add new connection to unit cell
@@ -64,6 +70,14 @@ class lattice: public graph{
     uint dimy;       // y
     uint dimz;       // z directions
     lattice_t type;  // Unit cell
+    std::vector<uint> faces[6];
+                     // Starting vertices of the bfs in each direction: the
+                     // start faces for +x,+y,+z then the end faces for -x,-y,-z
+    unionfind clusters;
+                     // Cluster labels used by findSpanning
+    std::vector<uint64_t> reach[6];
+                     // Reachability from each face used by findSpanning64
+    void findFaces();                 // Fill faces from the unit cell
     uint fromCoord(int h, int i, int j, int k)
       {return h+type.size*(i+dimx*(j+dimy*k));};
                      // Convert 4D coordinate to 1D index
@@ -97,16 +111,54 @@ class lattice: public graph{
   public:
     lattice(void);                // Empty constructor
     lattice(const lattice& lat);  // Copy constructor
-    lattice(lattice_t D, uint L, uint M, uint N);
+    lattice(lattice&& lat) noexcept;
+                                  // Move constructor
+    lattice(const lattice_t& D, uint L, uint M, uint N);
                                   // Construct a LxMxN lattice with unit cell D
     ~lattice(void);               // Destructor
-    lattice operator=(const lattice&);
+    lattice& operator=(const lattice&);
                                   // Assignment operator
+    lattice& operator=(lattice&&) noexcept;
+                                  // Move assignment operator
     // BFS-type stuff
-    void traverse();              // Perform bfs in all 6 directions
+    void traverse(bool fused=false);
+                                  // Perform bfs in all 6 directions
     std::vector<uint> findCrossings();
                                   // Find the smallest crossing clusters
+    std::vector<uint> findCrossings(uint which);
+                                  // Find only some of the smallest crossing
+                                  // clusters, running only the searches
+                                  // they need
+    uint cross(uint axis, bool length=true);
+                                  // Find the smallest crossing cluster along
+                                  // one axis, by bfs from both faces
+    void crossings(uint* minsizes);
+                                  // Find the smallest crossing clusters, as
+                                  // findCrossings, into an array of 7
+    static constexpr unsigned char masks[7] = {
+      1|8, 2|16, 4|32,              // x, y, z
+      1|2|8|16, 2|4|16|32, 1|4|8|32, // xy, yz, zx
+      63};                          // xyz
+                                  // Faces each kind of crossing cluster must
+                                  // reach, bit d for faces[d], in the order
+                                  // of findCrossings
+    static void crossing(const uint* distance, uint* minsizes);
+                                  // Update the smallest crossing clusters
+                                  // with those through a single vertex
+    template<typename T>
+    static void crossings(const T* const* dist, uint64_t n, uint* minsizes);
+                                  // Update the smallest crossing clusters
+                                  // with those through vertices 0...n-1
+    std::vector<bool> findSpanning();
+                                  // Find which crossing clusters exist, by
+                                  // union-find instead of bfs
+    std::vector<uint64_t> findSpanning64();
+                                  // Find which crossing clusters exist in
+                                  // each of the 64 trials of percolate64
     // Access methods
+    const std::vector<uint>& face(uint d) const {return faces[d];};
+                                  // Starting vertices of the bfs in
+                                  // direction d (see faces)
     std::string label() const {return type.label;};
                                   // Return the text label indicating the type
                                   // of lattice
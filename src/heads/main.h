@@ -4,8 +4,24 @@
 #ifndef h_main
 #define h_main
 
+#include "lattice.h"
+
 int main(int, char**);
 int test(int, char**);
 int run(int, char**);
+void trial(lattice*, double, uint, uint, bool, uint*);
+void climb(lattice*, const std::vector<double>&, uint, uint, uint*);
+int coupled(int, char**);
+uint bisect(lattice*, uint, uint, double, double*);
+int adapt(int, char**);
+int batch(int, char**);
+void header(std::ostream&, const std::string&, const uint*, const std::string&,
+  uint, const std::string& = "p p_x1d p_x2d p_x3d <l_1d> <l_2d> <l_3d>");
+void row(std::ostream&, double, const double*, const double*);
+void tabulate(const std::vector<double>&, uint, const uint*, std::ostream&,
+  bool=true);
+int sharded(int, char**);
+int span(int, char**);
+int sweep(int, char**);
 
 #endif
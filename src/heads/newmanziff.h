@@ -0,0 +1,50 @@
+// newmanziff.h
+// Header file for newmanziff class
+
+#ifndef h_newmanziff
+#define h_newmanziff
+
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+#include <gsl/gsl_rng.h>
+
+#include "lattice.h"
+#include "unionfind.h"
+
+class newmanziff{
+/* newmanziff class
+ * Newman-Ziff sweep over the bonds of a lattice. Each trial adds the bonds one
+ * at a time in random order, tracking with union-find the number of bonds
+ * needed before a 1D, 2D and 3D crossing cluster first appears. Crossing
+ * probabilities at any p then follow from a binomial convolution, so a single
+ * set of trials covers the whole p range.
+ */
+  private:
+    uint nvert;                       // Number of vertices
+    uint nbond;                       // Number of bonds
+    uint ntrials;                     // Number of trials so far
+    std::vector<uint32_t> ends;       // Endpoints of each bond, in pairs
+    std::vector<uint32_t> order;      // Order of bond addition in a trial
+    std::vector<unsigned char> facemask;
+                                      // Faces touched by each vertex
+    std::vector<unsigned char> touched;
+                                      // Faces touched by each cluster (only
+                                      // meaningful at cluster roots)
+    unionfind clusters;               // Clusters during a trial
+    std::vector<uint> first[3];       // first[d][n] : number of trials where
+                                      // a (d+1)D crossing first appeared
+                                      // with n bonds present
+  public:
+    newmanziff(const lattice& L);     // Sweep over the bonds of lattice L
+    void trial(uint seed=314);        // Run one trial
+    uint trials(void) const {return ntrials;};
+                                      // Number of trials so far
+    double crossing(uint d, double p) const;
+      // Probability of a (d+1)D crossing cluster (d = 0,1,2) at bond
+      // probability p
+};
+
+#endif
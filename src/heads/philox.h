@@ -0,0 +1,43 @@
+// philox.h
+// Header file for philox class
+
+#ifndef h_philox
+#define h_philox
+
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+
+class philox{
+/* philox class
+ * Counter-based random numbers (Philox4x32-10, Salmon et al. 2011). The nth
+ * number of the stream for a given (seed, trial) is a pure function of those
+ * three values, so numbers can be drawn in any order, by any thread, and any
+ * single trial can be replayed on its own.
+ * Each block of four numbers costs one evaluation of the generator; the last
+ * block is kept, so reading the stream in order costs a quarter of that per
+ * number.
+ */
+  private:
+    uint32_t key[2];      // Seed and trial
+    uint64_t last;        // Block held in out ((uint64_t)(-1) for none)
+    uint32_t out[4];      // Numbers 4*last ... 4*last+3 of the stream
+    static void block(const uint32_t* k, uint64_t n, uint32_t* r);
+                          // Evaluate the generator for block n, key k
+  public:
+    philox(uint seed, uint trial);
+                          // Stream for trial number trial of seed seed
+    uint32_t get(uint64_t n)
+      {if (n/4 != last){last = n/4; block(key, last, out);}; return out[n%4];};
+                          // The nth 32-bit number of the stream
+    void fill(uint64_t w, uint32_t* r) const;
+                          // Numbers 64w ... 64w+63 of the stream, computed
+                          // 16 blocks at a time
+    static uint64_t threshold(double p)
+      {return p >= 1 ? (uint64_t)1<<32 :
+        (p <= 0 ? 0 : (uint64_t)std::ldexp(p, 32));};
+                          // get(n) < threshold(p) with probability p, to
+                          // within 2^-32
+};
+
+#endif
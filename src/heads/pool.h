@@ -0,0 +1,52 @@
+// pool.h
+// Header file for pool class
+
+#ifndef h_pool
+#define h_pool
+
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <functional>
+
+class pool{
+/* pool class
+ * A set of worker threads sharing out the task indices 0...n-1. Each worker
+ * starts with a contiguous block of tasks and works from the front of it. A
+ * worker that runs dry steals the back half of another worker's block, so
+ * uneven task costs still keep every thread busy.
+ * Tasks are identified only by index, so callers that store results by task
+ * index get the same answer whatever the number of threads.
+ */
+  private:
+    class block{
+    /* block class
+     * Range of task indices [next, end) owned by one worker
+     */
+      public:
+        std::mutex lock;  // Guards next and end
+        uint next;        // Next task to run
+        uint end;         // One past the last task
+        block(void){next=end=0;};
+    };
+    uint nthreads;        // Number of worker threads
+    std::vector<block> blocks;
+                          // One block per worker
+    bool take(uint w, uint* task);
+                          // Get the next task for worker w
+    bool steal(uint w);   // Refill the block of worker w from another worker
+    void work(uint w, const std::function<void(uint, uint)>& f);
+                          // Body of worker thread w
+  public:
+    pool(uint n=0);       // Pool with n threads (0 for one per core)
+    uint threads(void) const {return nthreads;};
+                          // Number of worker threads
+    void run(uint ntasks, const std::function<void(uint, uint)>& f);
+      // Call f(task, worker) for every task in 0...ntasks-1 and wait for all
+      // of them to finish
+};
+
+#endif
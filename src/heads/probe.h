@@ -0,0 +1,60 @@
+// probe.h
+// Header file for probe class
+
+#ifndef h_probe
+#define h_probe
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+class probe{
+/* probe class
+ * Timers and counters for the phases of a trial, to find where the time goes
+ * in a long sweep. Only compiled in when PROBE is defined (make defs=-DPROBE);
+ * otherwise on is false, and every use of it in the hot paths is behind a
+ * test of on which the compiler removes.
+ * The hot paths record into active, which each thread points at its own
+ * probe, so no locking is needed. Probes are added up afterwards.
+ */
+  public:
+#ifdef PROBE
+    static constexpr bool on = true;
+#else
+    static constexpr bool on = false;
+#endif
+    enum phase_t {construct, percolate, traverse, crossings, nphases};
+                              // Phases timed separately
+    class timer{
+    /* Adds the time from construction to stop (or destruction) to a phase of
+     * active, if there is one
+     */
+      private:
+        phase_t phase;        // Phase to add to
+        bool running;         // Whether stop is still to come
+        std::chrono::steady_clock::time_point start;
+      public:
+        timer(phase_t p) : phase(p), running(on)
+          {if (on){start = std::chrono::steady_clock::now();}};
+        ~timer(void){stop();};
+        void stop(void);      // Stop timing, and add the time to active
+    };
+    static thread_local probe* active;
+                              // Where this thread records. NULL for nowhere
+    double seconds[nphases];  // Time spent in each phase
+    uint64_t trials;          // Number of trials
+    uint64_t closed;          // Bonds closed by percolate
+    uint64_t enqueued[6];     // Vertices queued by bfs in each direction
+    uint64_t peak;            // Largest level of any bfs
+    probe(void);              // All zero
+    void add(const probe& P); // Add the counts and times of P
+    void write(std::ostream& out, double p) const;
+                              // Write the trials of a point as a single JSON
+                              // object on one line
+    void write(std::ostream& out) const;
+                              // Write the construction time likewise
+};
+
+#endif
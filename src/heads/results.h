@@ -0,0 +1,96 @@
+// results.h
+// Header file for results class
+
+#ifndef h_results
+#define h_results
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <system_error>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+class results{
+/* results class
+ * Binary, append-only file of the crossing sizes of every trial of a sweep,
+ * which doubles as its checkpoint. The file is a header describing the sweep
+ * followed by chunks, each of which holds a batch of trials column by column:
+ *   "percres1", then uint32 version, seed, nreps, npoints, dimx, dimy, dimz,
+ *   lengths (1 for sizes, 0 for existence only, see trial), then the label
+ *   of the unit cell (32 bytes, zero padded), then the npoints values of p
+ *   (doubles)
+ *   each chunk: uint32 "chnk", uint32 count, then count uint32 each of trial
+ *   number, 1D, 2D and 3D size
+ * Sizes are as set by trial, (uint)(-1) for none. The bonds of trial t are
+ * drawn from the stream (seed, t) (see philox), so the seed and trial number
+ * are all that is needed to replay any trial, and are all that is stored.
+ * Every field is 4-byte aligned so the file can be mapped and read in place.
+ * Trials are handed over by put, which only takes a lock to queue them. A
+ * background thread writes them out a chunk at a time, at least once a
+ * second, so a killed job loses at most the trials of the last second.
+ * Opening the file again for the same sweep reads back the trials it holds,
+ * dropping any chunk cut short, and appends after them. Opening it for a
+ * different sweep moves it aside first, so no results are ever lost.
+ * Errors never end the process: the constructor throws, and a write that
+ * fails in the background is handed back by put and close.
+ */
+  private:
+    static const uint32_t version = 1;
+    static const uint32_t tag = 0x6b6e6863;   // "chnk" on little-endian
+    std::string path;             // File name
+    int fd;                       // File descriptor of path
+    uint npoints, nreps;          // Shape of the sweep
+    std::vector<bool> done;       // Whether each trial is in the file
+    std::vector<uint32_t> pending;// Trials waiting for the writer, four words
+                                  // each: trial number, 1D, 2D and 3D size
+    bool closing;                 // Whether close has been called
+    int failed;                   // errno of a failed write, 0 if none
+    std::mutex lock;              // Guards pending, closing and failed
+    std::condition_variable wake; // Signalled when there is work or on close
+    std::thread writer;           // Background thread running write
+    std::vector<char> header(const std::string& label, const uint* dims,
+      uint seed, const std::vector<double>& ps, bool lengths) const;
+                                  // Bytes of the header for a sweep
+    bool load(const std::vector<char>& head, uint* sizes);
+                                  // Read back the trials in an existing file
+    void write(void);             // Writer thread: write out pending trials
+    void fail(const std::string& what);
+                                  // Close the file and throw for errno
+  public:
+    results(const std::string& file, const std::string& label,
+      const uint* dims, uint seed, uint nreps, const std::vector<double>& ps,
+      bool lengths, uint* sizes);
+                                  // Open file for a sweep, resuming from it
+                                  // if it holds the same sweep
+    results(const results&) = delete;
+                                  // Owns a thread, so cannot be copied
+    ~results(void);               // Close, if not closed already
+    bool has(uint t) const {return done[t];};
+                                  // Whether trial t is in the file
+    uint count(void) const
+      {return std::count(done.begin(), done.end(), true);};
+                                  // Number of trials in the file when opened
+    bool put(uint t, const uint* sizes);
+                                  // Queue trial t for writing. False if the
+                                  // writer has failed
+    bool close(void);             // Write everything out and stop the writer.
+                                  // False if any trial was not written
+    int error(void)
+      {std::lock_guard<std::mutex> guard(lock); return failed;};
+                                  // errno of a failed write, 0 if none
+};
+
+#endif
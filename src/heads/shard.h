@@ -0,0 +1,83 @@
+// shard.h
+// Header file for shard class
+
+#ifndef h_shard
+#define h_shard
+
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <thread>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+class shard{
+/* shard class
+ * Hands out the trials of a sweep to worker processes over a local Unix
+ * socket, and gathers their results. The trials are cut into units, each a
+ * run of consecutive trial numbers at a single p. A worker asks for a unit,
+ * runs it, and sends back the sizes of its trials along with its next
+ * request. If a worker goes away while it holds a unit, the unit goes back on
+ * the queue for the next worker to ask, so a dying worker costs only the unit
+ * it was running.
+ * Each trial only depends on the lattice, p, the seed and its trial number,
+ * so the sizes gathered are the same whichever worker runs which unit, and
+ * whatever happened along the way. The lattice is not sent, so each side
+ * names the sweep it runs, e.g. by the label and dimensions of its lattice,
+ * and workers naming another sweep are refused.
+ * Messages are fixed-size words in the byte order of the machine:
+ *   worker to coordinator: uint32 unit, count, then 3*count sizes. The first
+ *     message of a worker has unit (uint32)(-1), and count the length of its
+ *     name for the sweep, which follows as that many bytes
+ *   coordinator to worker: a unit (see below), or one with id (uint32)(-1)
+ *     when there is nothing left to do, or (uint32)(-2) when the worker named
+ *     another sweep
+ */
+  public:
+    class unit{
+    /* A run of trials for a worker
+     */
+      public:
+        uint32_t id;          // Index of the unit in the list being served
+        uint32_t seed;        // Seed value for rng
+        uint32_t first;       // First trial number
+        uint32_t count;       // Number of trials
+        double p;             // Probability of forming bonds
+    };
+  private:
+    std::string path;         // Path of the socket, removed by the destructor
+    std::string sweep;        // Name of the sweep, which workers must give
+    int listener;             // Listening socket, -1 once served
+    static bool full(int fd, void* buf, size_t n, bool out);
+                              // Read or write exactly n bytes
+  public:
+    shard(const std::string& path, const std::string& sweep);
+                              // Listen on a new socket at path
+    shard(const shard&) = delete;
+                              // Owns the socket, so cannot be copied
+    ~shard(void);
+    bool serve(const std::vector<unit>& units, uint* sizes,
+      std::vector<pid_t>* workers = NULL);
+                              // Hand out units until every one has come
+                              // back, or every worker has gone, then stop
+                              // listening
+    static bool work(const std::string& path, const std::string& sweep,
+      const std::function<void(const unit&, uint*)>& body);
+                              // Worker: run units from the coordinator at
+                              // path until it has none left
+};
+
+#endif
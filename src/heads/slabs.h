@@ -0,0 +1,89 @@
+// slabs.h
+// Header file for slabs class
+
+#ifndef h_slabs
+#define h_slabs
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "implicit.h"
+
+class slabs : public implicit{
+/* slabs class
+ * Implicit lattice for sizes which do not fit in memory. The lattice is cut
+ * into slabs of whole z layers of unit cells. Bond states are never stored for
+ * the whole lattice: they are worked out from the counter-based stream (see
+ * philox) as they are needed, and held for at most three slabs at a time.
+ * They come out the same as implicit::percolate would give. The distances of
+ * the six searches are kept in a memory-mapped file, which traverse works
+ * through a slab at a time, telling the kernel which slab it needs next.
+ * Unit cells have bonds to the layers above and below (z offsets of +-1), so
+ * paths can leave a slab and come back. Each slab is solved exactly given the
+ * current distances on either side of it, and passes go up and down the
+ * lattice, revisiting only slabs next to a boundary that changed, until
+ * nothing changes.
+ */
+  private:
+    std::string path;             // Scratch file for the distances, removed
+                                  // by the destructor
+    int fd;                       // File descriptor of path
+    uint32_t* dist;               // Mapped distances. Direction d at
+                                  // dist+d*size, (uint32_t)(-1) if unvisited
+    uint64_t layer;               // Number of vertices in each z layer
+    uint depth;                   // Number of z layers in each slab
+    uint nslabs;                  // Number of slabs
+    philox rng;                   // Bond state, from percolate
+    uint64_t threshold;
+    std::vector<uint8_t> bonds[3];// Open slots of the vertices of a slab, for
+    std::vector<bool> known[3];   // the vertices marked known so far
+    int held[3];                  // Slab in bonds[k] (s%3 == k), -1 if none
+    std::vector<std::pair<uint32_t, uint> > sources;
+                                  // Vertices of the slab being solved to
+                                  // start from, and their distances
+    std::vector<uint> fifo;       // Queue for the bfs within a slab
+    uint64_t first(uint s) const {return (uint64_t)s*depth*layer;};
+                                  // Index of the first vertex of slab s
+    uint64_t count(uint s) const
+      {return (uint64_t)(std::min(dimz, (s+1)*depth)-s*depth)*layer;};
+                                  // Number of vertices in slab s
+    template<class C> uint8_t slots(const C& cell, uint64_t n);
+                                  // Open slots of vertex n, working them out
+                                  // if they are not known
+    template<class C> uint solve(const C& cell, uint32_t* d, uint s, bool all);
+                                  // Distances within slab s
+    template<class C> void traverse(const C& cell);
+                                  // Perform bfs in all 6 directions
+    void advise(const uint32_t* d, uint s, int advice);
+                                  // madvise the pages of slab s of d
+    using implicit::findSpanning; // These need the bond state of every
+    using implicit::isOpen;       // vertex, so are not available
+  public:
+    slabs(const lattice_t& D, uint L, uint M, uint N, const std::string& file,
+      uint depth=0);
+                                  // Construct a LxMxN lattice with unit cell
+                                  // D, with distances in file
+    slabs(const slabs&) = delete; // Owns the mapping, so cannot be copied
+    slabs& operator=(const slabs&) = delete;
+    ~slabs(void);
+    void percolate(double p, uint seed=314, uint trial=0);
+                                  // Open each bond with probability p, for
+                                  // trial number trial of seed
+    void traverse();              // Perform bfs in all 6 directions
+    std::vector<uint> findCrossings();
+                                  // Find the smallest crossing clusters
+};
+
+#endif
@@ -0,0 +1,30 @@
+// unionfind.h
+// Header file for unionfind class
+
+#ifndef h_unionfind
+#define h_unionfind
+
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+class unionfind{
+/* unionfind class
+ * Disjoint set forest over the integers 0...n-1, with path compression and
+ * union by rank. Used to label clusters without doing a full bfs.
+ */
+  private:
+    std::vector<uint> parent;         // Parent in the forest (self for roots)
+    std::vector<unsigned char> rank;  // Upper bound on height of each tree
+  public:
+    unionfind(void);        // Empty constructor. No elements
+    unionfind(uint n);      // Create n singleton sets
+    void reset(uint n);     // Return to n singleton sets, reusing storage
+    uint find(uint i);      // Find the root of the set containing i
+    uint merge(uint i, uint j);
+      // Merge the sets containing i and j. Returns the new root
+    uint size(void) const {return parent.size();};
+      // Number of elements
+};
+
+#endif
@@ -0,0 +1,243 @@
+/* implicit.cc
+ * implicit lattice class
+ * - Same lattices as the lattice class, built from a lattice_t unit cell
+ * - No adjacency is stored: neighbours come from the unit cell on the fly
+ * - One byte of bond state per vertex
+ */
+
+#include "heads/implicit.h"
+
+implicit::implicit(const lattice_t& D, uint L, uint M, uint N, bool store){
+/* Constructor
+ * Sets up an LxMxN lattice with unit cell D, with every bond closed
+ * L,M,N : dimensions of lattice
+ * D     : lattice_t object describing unit cell. At most 8 connections out
+ *         of each vertex, or std::invalid_argument is thrown
+ * store : whether to keep the bond state of every vertex. Derived classes
+ *         which work out bond states as they go (see slabs) need not
+ */
+  uint h, j;
+  dimx = L;
+  dimy = M;
+  dimz = N;
+  type = D;
+  ncell = D.size;
+  size = (uint64_t)L*M*N*ncell;
+  kernel = cells::lookup(D);
+  degree.assign(ncell, 0);
+  links.assign(8*ncell, cells::link{0,0,0,0});
+  reverse.assign(8*ncell, -1);
+  for (uint w=0; w<ncell; w++){
+    degree[w] = D.adjacency[w].size();
+    if (degree[w] > 8){
+      throw std::invalid_argument("implicit: unit cell vertex " +
+        std::to_string(w) + " has more than 8 connections");
+    }
+    for (uint i=0; i<degree[w]; i++){
+      links[8*w+i] = {(int)D.adjacency[w][i].h, D.adjacency[w][i].i,
+        D.adjacency[w][i].j, D.adjacency[w][i].k};
+    }
+  }
+  // Pair each slot with the slot leading back, so both ends of a bond agree
+  for (uint w=0; w<ncell; w++){
+    for (uint i=0; i<degree[w]; i++){
+      if (reverse[8*w+i] >= 0){
+        continue;
+      }
+      const cells::link& a = links[8*w+i];
+      h = a.h;
+      for (j=0; j<degree[h]; j++){
+        const cells::link& b = links[8*h+j];
+        if (b.h == (int)w && reverse[8*h+j] < 0 && !(h == w && j == i) &&
+            b.i == -a.i && b.j == -a.j && b.k == -a.k){
+          reverse[8*w+i] = j;
+          reverse[8*h+j] = i;
+          break;
+        }
+      }
+    }
+  }
+  if (store){
+    open.assign(size, 0);
+  }
+}
+
+template<class C>
+void implicit::percolate(const C& cell, uint64_t t, philox* r){
+/* Open each bond with probability t/2^32. Each bond is drawn once, by the end
+ * with the smaller index, as number 8n+i of the stream for slot i of vertex
+ * n. With a cells::fixed cell the loops over the cell vertices and their
+ * slots have constant bounds and unroll.
+ * cell : unit cell, cells::fixed or runtime
+ * t    : threshold, from philox::threshold
+ * r    : stream to draw from
+ */
+  uint64_t n=0, u;
+  uint c[4];
+  int back;
+  for (c[3]=0; c[3]<dimz; c[3]++){
+    for (c[2]=0; c[2]<dimy; c[2]++){
+      for (c[1]=0; c[1]<dimx; c[1]++){
+        for (c[0]=0; c[0]<cell.size(); c[0]++, n++){
+          for (uint i=0; i<cell.degree(c[0]); i++){
+            back = reverse[8*c[0]+i];
+            if (!neighbour(cell, c, i, &u) ||
+                (back >= 0 && (u < n || (u == n && back < (int)i)))){
+              continue; // Outside the lattice, or drawn from the other end
+            }
+            if (r->get(8*n+i) < t){
+              open[n] |= 1<<i;
+              if (back >= 0){
+                open[u] |= 1<<back;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void implicit::percolate(double p, uint seed, uint trial){
+/* Percolate the lattice: open each bond independently with probability p.
+ * The state of each bond depends only on seed, trial and the bond, as for
+ * graph::percolate. Uses the kernel compiled for the unit cell if there is
+ * one.
+ * p     : probability of forming bonds.
+ * seed  : seed value for rng
+ * trial : trial number. Trials with the same seed are independent
+ */
+  philox r(seed, trial);
+  uint64_t t = philox::threshold(p);
+  open.assign(size, 0);
+  switch (kernel){
+    case 1: percolate(cells::fixed<cells::cubic>(), t, &r); break;
+    case 2: percolate(cells::fixed<cells::raussendorf>(), t, &r); break;
+    case 3: percolate(cells::fixed<cells::diamond>(), t, &r); break;
+    case 4: percolate(cells::fixed<cells::diamond_grid>(), t, &r); break;
+    default: percolate(runtime{*this}, t, &r); break;
+  }
+}
+
+template<class C, typename F>
+void implicit::search(const C& cell, F visit){
+/* Breadth first search over the open bonds, starting from the queued
+ * vertices, until the queue is empty.
+ * cell  : unit cell, cells::fixed or runtime
+ * visit : called as visit(v, u) for each open bond from a queued vertex v.
+ *         Returns true if u is newly reached and should be queued
+ */
+  uint64_t v, u;
+  uint c[4];
+  while (!queue.empty()){
+    v = queue.front();
+    queue.pop_front();
+    toCoord(cell, v, c);
+    for (uint i=0; i<cell.degree(c[0]); i++){
+      if ((open[v]>>i & 1) && neighbour(cell, c, i, &u) && visit(v, u)){
+        queue.push_back(u);
+      }
+    }
+  }
+}
+
+template<typename F>
+void implicit::search(F visit){
+/* Breadth first search from the queue, using the kernel compiled for the
+ * unit cell if there is one
+ * visit : as for search(cell, visit)
+ */
+  switch (kernel){
+    case 1: search(cells::fixed<cells::cubic>(), visit); break;
+    case 2: search(cells::fixed<cells::raussendorf>(), visit); break;
+    case 3: search(cells::fixed<cells::diamond>(), visit); break;
+    case 4: search(cells::fixed<cells::diamond_grid>(), visit); break;
+    default: search(runtime{*this}, visit); break;
+  }
+}
+
+void implicit::traverse(){
+/* Find the distance of every vertex from the start and end faces of the
+ * lattice, as lattice::traverse does. Needs 24 bytes per vertex.
+ */
+  for (uint d=0; d<6; d++){
+    std::vector<uint32_t>& dist = distance[d];
+    dist.assign(size, (uint32_t)-1);
+    face(d, [&](uint64_t v){
+      dist[v] = 0;
+      queue.push_back(v);
+    });
+    search([&](uint64_t v, uint64_t u){
+      if (dist[u] != (uint32_t)-1){
+        return false;
+      }
+      dist[u] = dist[v]+1;
+      return true;
+    });
+  }
+}
+
+std::vector<uint> implicit::findCrossings(){
+/* Find the size of the smallest crossing clusters after traverse, in the same
+ * form as lattice::findCrossings
+ */
+  std::vector<uint> minsizes(7,(uint)-1);
+  const uint32_t* d[6];
+  for (uint k=0; k<6; k++){
+    d[k] = distance[k].data();
+  }
+  lattice::crossings(d, size, minsizes.data());
+  for (uint i=0; i<7; i++){
+    if (minsizes[i] != (uint)-1){
+      minsizes[i]++;
+    }
+  }
+  return minsizes;
+}
+
+std::vector<bool> implicit::findSpanning(){
+/* Find which crossing clusters exist, in the same form as
+ * lattice::findSpanning. Reachability from each face is kept as one bit per
+ * vertex, so this needs under one byte per vertex on top of the bond state.
+ */
+  const unsigned char* masks = lattice::masks;
+  std::vector<bool> spans(7,false);
+  std::vector<uint64_t> reached[6];
+  uint64_t w, nwords=(size+63)/64;
+  for (uint d=0; d<6; d++){
+    std::vector<uint64_t>& bits = reached[d];
+    bits.assign(nwords, 0);
+    face(d, [&](uint64_t v){
+      bits[v/64] |= (uint64_t)1<<(v%64);
+      queue.push_back(v);
+    });
+    search([&](uint64_t, uint64_t u){
+      if (bits[u/64]>>(u%64) & 1){
+        return false;
+      }
+      bits[u/64] |= (uint64_t)1<<(u%64);
+      return true;
+    });
+  }
+  for (uint64_t n=0; n<nwords; n++){
+    for (uint c=0; c<7; c++){
+      w = ~(uint64_t)0;
+      for (uint d=0; d<6; d++){
+        if (masks[c] & (1<<d)){
+          w &= reached[d][n];
+        }
+      }
+      if (w){
+        spans[c] = true;
+      }
+    }
+  }
+  return spans;
+}
+
+void implicit::print(void){
+/* Print summary of the lattice to cout
+ */
+  std::cout << type.label << " lattice of size " << dimx << " x " << dimy <<
+    " x " << dimz << " (implicit, " << size << " vertices)" << std::endl;
+}
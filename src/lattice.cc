@@ -6,9 +6,12 @@
  */
 
 # include "heads/lattice.h"
+# include "heads/cells.h"
 
 //--------------------LATTICE METHODS-----------------------------------------//
 
+constexpr unsigned char lattice::masks[7];
+
 lattice::lattice(void){
 /* Empty constructor
  */
@@ -19,39 +22,29 @@ lattice::lattice(void){
   type = lattice_t();
 }
 
-lattice::lattice(const lattice& lat) : graph(lat.size){
-/* Copy constructor with deep copy of adjacency list
+lattice::lattice(const lattice& lat) : graph(lat){
+/* Copy constructor. The adjacency is shared with lat (see graph), so only the
+ * state of the trial is copied
  * lat : lattice to copy
  */
   dimx = lat.dimx;
   dimy = lat.dimy;
   dimz = lat.dimz;
   type = lat.type;
-  //adj = new vertex[size];
-  vertex *u, *v;
-  uint n;
-  for (uint i=0; i<size; i++){
-    // Copy the vertex manually
-    u = adj+i;
-    v = lat.adj+i;
-    for (uint j=0; j<6; j++){
-      u->visited[j] = v->visited[j];
-      u->distance[j] = v->distance[j];
-      u->parent[j] = u+(v->parent[j]-v);
-      u->clusterid[j] = v->clusterid[j];
-    }
-    n = v->adj.size();
-    for (uint j=0; j<n; j++){
-      u->add(u+(v->adj[j]-v)); // Retain relative positions
-    }
+  for (uint d=0; d<6; d++){
+    faces[d] = lat.faces[d];
+    reach[d] = lat.reach[d];
   }
 }
 
-lattice::lattice(lattice_t D, uint L, uint M, uint N) : graph(L*M*N*D.size){
+lattice::lattice(const lattice_t& D, uint L, uint M, uint N) :
+    graph(L*M*N*D.size){
 /* Constructor
  * Generates an LxMxN lattice from the unit cell D
  * L,M,N : dimensions of lattice
- * D     : lattice_t object describing unit cell
+ * D     : lattice_t object describing unit cell. If any vertex ends up with
+ *         more than 8 neighbours, std::invalid_argument is thrown (see
+ *         graph::build)
  */
   dimx = L;
   dimy = M;
@@ -60,9 +53,16 @@ lattice::lattice(lattice_t D, uint L, uint M, uint N) : graph(L*M*N*D.size){
   uint n=0;
   uint connect=0;
   int outw, outx, outy, outz, w,x,y,z;
+  uint maxdeg=0;
+  std::vector<uint32_t> rows(size+1), adj;
+  for (uint i=0; i<D.size; i++){
+    maxdeg = std::max(maxdeg, (uint)D.adjacency[i].size());
+  }
+  adj.reserve(size*maxdeg);
   for (iterator I(D.size, dimx, dimy, dimz); I<size; I++){
     w=I[0]; x=I[1]; y=I[2]; z=I[3];
     n = I.index();
+    rows[n] = adj.size();
     for (uint i=0; i<D.adjacency[w].size(); i++){
       outw = D.adjacency[w][i].h;
       outx = x + D.adjacency[w][i].i;
@@ -72,10 +72,14 @@ lattice::lattice(lattice_t D, uint L, uint M, uint N) : graph(L*M*N*D.size){
           outy >= 0 && outy < (int)dimy &&
           outz >= 0 && outz < (int)dimz){
         connect = fromCoord(outw, outx, outy, outz);
-        adj[n].add(adj+connect);
+        adj.push_back(connect);
       }
     }
   }
+  rows[size] = adj.size();
+  build(rows, adj);
+  restore();
+  findFaces();
 }
 
 lattice::~lattice(void){
@@ -83,157 +87,127 @@ lattice::~lattice(void){
  */
 }
 
-lattice lattice::operator=(const lattice &lat){
-/* Assignment operator with deep copy of adjacency list
+lattice::lattice(lattice&& lat) noexcept :
+    graph(std::move(lat)), type(std::move(lat.type)){
+/* Move constructor. Takes over the storage of lat, leaving it empty. Nothing
+ * is allocated, so it cannot fail
+ * lat : lattice to move from
+ */
+  dimx = lat.dimx;
+  dimy = lat.dimy;
+  dimz = lat.dimz;
+  for (uint d=0; d<6; d++){
+    faces[d].swap(lat.faces[d]);
+    reach[d].swap(lat.reach[d]);
+  }
+  lat.dimx = lat.dimy = lat.dimz = 0;
+}
+
+lattice& lattice::operator=(const lattice &lat){
+/* Assignment operator. The adjacency is shared with lat, as for the copy
+ * constructor
  * lat : lattice to copy
  */
-  delete[] adj;
-  size = lat.size;
+  if (this == &lat){
+    return *this;
+  }
+  graph::operator=(lat);
   dimx = lat.dimx;
   dimy = lat.dimy;
   dimz = lat.dimz;
   type = lat.type;
-  adj = new vertex[size];
-  vertex *u, *v;
-  uint n;
-  for (uint i=0; i<size; i++){
-    // Copy the vertex manually
-    u = adj+i;
-    v = lat.adj+i;
-    for (uint j=0; j<6; j++){
-      u->visited[j] = v->visited[j];
-      u->distance[j] = v->distance[j];
-      u->parent[j] = u+(v->parent[j]-v);
-      u->clusterid[j]=v->clusterid[j];
-    }
-    n = v->adj.size();
-    for (uint j=0; j<n; j++){
-      u->add(u+(v->adj[j]-v)); // Retain relative positions
-    }
+  for (uint d=0; d<6; d++){
+    faces[d] = lat.faces[d];
+    reach[d] = lat.reach[d];
   }
   return *this;
 }
 
-// BFS-type stuff
-void lattice::traverse(){
-/* Find the connected clusters of the lattice by doing successive traverses in
- * the positive and negative x, y and z directions.
- * After running, each vertex in the lattice will have 6 indices (one for each
- * direction) indicating which clusters it is in.
- * More processing is required to find which (if any) of these are crossing
- * clusters
+lattice& lattice::operator=(lattice&& lat) noexcept{
+/* Move assignment operator. Takes over the storage of lat, which is left
+ * with the old state of this lattice to free
+ * lat : lattice to move from
  */
-  uint i,j,k,idx;
-  std::queue<vertex*> Q;
-  vertex *v;
+  graph::operator=(std::move(lat));
+  std::swap(dimx, lat.dimx);
+  std::swap(dimy, lat.dimy);
+  std::swap(dimz, lat.dimz);
+  std::swap(type, lat.type);
+  for (uint d=0; d<6; d++){
+    faces[d].swap(lat.faces[d]);
+    reach[d].swap(lat.reach[d]);
+  }
+  return *this;
+}
 
-// +x direction
-  i=0;
-  idx=1;
+void lattice::findFaces(){
+/* Fill the lists of starting vertices for the bfs in each direction from the
+ * start and end vertices of the unit cell.
+ * faces[0...2] are the cells with x, y or z equal to zero, faces[3...5] the
+ * cells with x, y or z at its maximum.
+ */
+  uint i,j,k;
+  for (uint d=0; d<6; d++){
+    faces[d].clear();
+  }
+  if (size == 0){
+    return;
+  }
+// +x and -x directions
   for (k=0; k<dimz; k++){
     for (j=0; j<dimy; j++){
       for (auto h : type.startx){
-        idx=fromCoord(h,i,j,k);
-        v=adj+idx;
-        v->parent[0]=v;
-        v->distance[0]=0;
-        v->visited[0]=true;
-        v->clusterid[0]=0;
-        Q.push(adj+idx);
+        faces[0].push_back(fromCoord(h,0,j,k));
+      }
+      for (auto h : type.endx){
+        faces[3].push_back(fromCoord(h,dimx-1,j,k));
       }
     }
   }
-  bfs(&Q, 0);
-
-// +y direction
-  j=0;
-  idx=1;
+// +y and -y directions
   for (k=0; k<dimz; k++){
     for (i=0; i<dimx; i++){
       for (auto h : type.starty){
-        idx=fromCoord(h,i,j,k);
-        v=adj+idx;
-        v->parent[1]=v;
-        v->distance[1]=0;
-        v->visited[1]=true;
-        v->clusterid[1]=0;
-        Q.push(adj+idx);
+        faces[1].push_back(fromCoord(h,i,0,k));
+      }
+      for (auto h : type.endy){
+        faces[4].push_back(fromCoord(h,i,dimy-1,k));
       }
     }
   }
-  bfs(&Q, 1);
-
-// +z direction
-  k=0;
-  idx=1;
+// +z and -z directions
   for (j=0; j<dimy; j++){
     for (i=0; i<dimx; i++){
       for (auto h : type.startz){
-        idx=fromCoord(h,i,j,k);
-        v=adj+idx;
-        v->parent[2]=v;
-        v->distance[2]=0;
-        v->visited[2]=true;
-        v->clusterid[2]=0;
-        Q.push(adj+idx);
+        faces[2].push_back(fromCoord(h,i,j,0));
       }
-    }
-  }
-  bfs(&Q, 2);
-
-// -x direction
-  i=dimx-1;
-  idx=1;
-  for (k=0; k<dimz; k++){
-    for (j=0; j<dimy; j++){
-      for (auto h : type.endx){
-        idx=fromCoord(h,i,j,k);
-        v=adj+idx;
-        v->parent[3]=v;
-        v->distance[3]=0;
-        v->visited[3]=true;
-        v->clusterid[3]=0;
-        Q.push(adj+idx);
+      for (auto h : type.endz){
+        faces[5].push_back(fromCoord(h,i,j,dimz-1));
       }
     }
   }
-  bfs(&Q, 3);
+}
 
-// -y direction
-  j=dimy-1;
-  idx=1;
-  for (k=0; k<dimz; k++){
-    for (i=0; i<dimx; i++){
-      for (auto h : type.endy){
-        idx=fromCoord(h,i,j,k);
-        v=adj+idx;
-        v->parent[4]=v;
-        v->distance[4]=0;
-        v->visited[4]=true;
-        v->clusterid[4]=0;
-        Q.push(adj+idx);
-      }
-    }
+// BFS-type stuff
+void lattice::traverse(bool fused){
+/* Find the connected clusters of the lattice by traversing in the positive
+ * and negative x, y and z directions.
+ * After running, each vertex in the lattice will have 6 distances (one for
+ * each direction) from the faces it was reached from.
+ * More processing is required to find which (if any) of these are crossing
+ * clusters
+ * fused : search all six directions together (see graph::bfs) rather than one
+ *         after the other. This only pays off when the wavefronts from
+ *         different faces tend to reach vertices on the same level; on the
+ *         unit cells here they rarely do, so it is off by default
+ */
+  if (fused){
+    bfs(faces);
+    return;
   }
-  bfs(&Q, 4);
-
-// -z direction
-  k=dimz-1;
-  idx=1;
-  for (j=0; j<dimy; j++){
-    for (i=0; i<dimx; i++){
-      for (auto h : type.endz){
-        idx=fromCoord(h,i,j,k);
-        v=adj+idx;
-        v->parent[5]=v;
-        v->distance[5]=0;
-        v->visited[5]=true;
-        v->clusterid[5]=0;
-        Q.push(adj+idx);
-      }
-    }
+  for (uint d=0; d<6; d++){
+    bfs(faces[d], d);
   }
-  bfs(&Q, 5);
 }
 
 std::vector<uint> lattice::findCrossings(){
@@ -246,73 +220,301 @@ std::vector<uint> lattice::findCrossings(){
  * The final element is the size of the 3D crossing cluster
  * A value of (uint)(-1) indicates that no crossing cluster exists
  */
-  uint len=-1;
+  std::vector<uint> minsizes(7);
+  crossings(minsizes.data());
+  return minsizes;
+}
+
+void lattice::crossings(uint* minsizes){
+/* Find the size of the smallest crossing clusters, the same as findCrossings,
+ * without allocating anything.
+ * minsizes : array of 7 uints, overwritten
+ */
+  const uint32_t* d32[6];
+  const uint16_t* d16[6];
+  for (uint i=0; i<7; i++){
+    minsizes[i] = (uint)-1;
+  }
+  for (uint k=0; k<6; k++){
+    d32[k] = dist32[k].data();
+    d16[k] = dist16[k].data();
+  }
+  if (wide){
+    crossings(d32, size, minsizes);
+  }
+  else{
+    crossings(d16, size, minsizes);
+  }
+  for (uint i=0; i<7; i++){
+    if (minsizes[i] != (uint)-1){
+      minsizes[i]++;
+    }
+  }
+}
+
+std::vector<uint> lattice::findCrossings(uint which){
+/* Find the size of some of the smallest crossing clusters, from the current
+ * bond state. Only the directions needed by the 2D and 3D clusters asked for
+ * are searched, after which findCrossings gives those clusters. 1D clusters
+ * not covered by them are found by cross, which stops as soon as the two
+ * faces meet. So for instance asking for the 3D cluster alone runs six
+ * searches, and asking for the x cluster alone runs at most one partial one.
+ * Overwrites the distances of the vertices.
+ * which : bit k set to find element k of the result of findCrossings
+ * Returns a vector of 7 uints in the same order as findCrossings. Elements
+ * not asked for are (uint)(-1)
+ */
   std::vector<uint> minsizes(7,(uint)-1);
-  vertex *v;
-  for (uint i=0; i<size; i++){
-    v=adj+i;
-    if (v->distance[0]!=(uint)-1 && v->distance[3]!=(uint)-1){
-      // Find x size
-      len  = v->distance[0]+v->distance[3];
-      if (len < minsizes[0]){
-        minsizes[0]=len;
-      }
+  unsigned char dirs=0;
+  for (uint c=3; c<7; c++){
+    if (which>>c & 1){
+      dirs |= masks[c];
     }
-    if (v->distance[1]!=(uint)-1 && v->distance[4]!=(uint)-1){
-      // Find y size
-      len  = v->distance[1]+v->distance[4];
-      if (len < minsizes[1]){
-        minsizes[1]=len;
+  }
+  if (dirs){
+    reset();
+    for (uint d=0; d<6; d++){
+      if (dirs>>d & 1){
+        bfs(faces[d], d);
       }
     }
-    if (v->distance[2]!=(uint)-1 && v->distance[5]!=(uint)-1){
-      // Find z size
-      len  = v->distance[2]+v->distance[5];
-      if (len < minsizes[2]){
-        minsizes[2]=len;
-      }
+    // Directions not searched are unvisited everywhere, so only the clusters
+    // they allow come out of the scan
+    crossings(minsizes.data());
+  }
+  for (uint c=0; c<3; c++){
+    if ((which>>c & 1) && (dirs & masks[c]) != masks[c]){
+      minsizes[c] = cross(c);
     }
-    if (v->distance[0]!=(uint)-1 && v->distance[1]!=(uint)-1 &&
-        v->distance[3]!=(uint)-1 && v->distance[4]!=(uint)-1){
-      // Find xy size 
-      len  = v->distance[0]+v->distance[1]+v->distance[3]+v->distance[4];
-      if (len < minsizes[3]){
-        minsizes[3]=len;
-      }
+  }
+  for (uint c=0; c<7; c++){
+    if (!(which>>c & 1)){
+      minsizes[c] = (uint)-1;
     }
-    if (v->distance[1]!=(uint)-1 && v->distance[2]!=(uint)-1 &&
-        v->distance[4]!=(uint)-1 && v->distance[5]!=(uint)-1){
-      // Find yz size 
-      len  = v->distance[1]+v->distance[2]+v->distance[4]+v->distance[5];
-      if (len < minsizes[4]){
-        minsizes[4]=len;
-      }
+  }
+  return minsizes;
+}
+
+uint lattice::cross(uint axis, bool length){
+/* Find the size of the smallest crossing cluster along one axis, the same as
+ * element axis of findCrossings after traverse, by searching from the start
+ * and end faces at once (see graph::meet). Neither search goes past the point
+ * where they meet. Does not use or change the distances of traverse, unless
+ * the lattice is not symmetric (see graph::symmetric, set by graph::build).
+ * Then the two searches of traverse are run in full, since the crossing
+ * clusters it finds are then pairs of paths out from the faces rather than
+ * paths from one to the other.
+ * axis   : 0, 1 or 2 for x, y or z
+ * length : if false, only find whether there is a crossing cluster, stopping
+ *          at the first path from one face to the other
+ * returns the number of vertices of the smallest crossing cluster, or 0 if
+ * length is false and there is one. (uint)(-1) if there is none
+ */
+  uint len, minsizes[7];
+  if (!symmetric){
+    reset();
+    bfs(faces[axis], axis);
+    bfs(faces[axis+3], axis+3);
+    crossings(minsizes);
+    len = minsizes[axis];
+    return (len == (uint)-1 || length) ? len : 0;
+  }
+  len = meet(faces[axis], faces[axis+3], length);
+  if (len == (uint)-1 || !length){
+    return len;
+  }
+  return len+1;
+}
+
+template<typename T>
+void lattice::crossings(const T* const* dist, uint64_t n, uint* minsizes){
+/* Scan over the vertices for findCrossings, four at a time. Each lane holds
+ * one vertex, and a crossing through it costs the sum of its distances in the
+ * directions involved, ORed with an all-ones mask for each of those that is
+ * unvisited. So a cluster a vertex is not on comes out as (uint)(-1) and
+ * drops out of the running minimum, with no branches on the distances.
+ * Vertices left over at the end are done one at a time by crossing.
+ * dist     : distances in each of the six directions, largest value of T for
+ *            unvisited
+ * n        : number of vertices
+ * minsizes : smallest total distance for each kind of crossing cluster, in
+ *            the order of findCrossings. Updated
+ */
+  typedef uint32_t quad __attribute__((vector_size(16)));
+  const quad zero = {};
+  const quad unvisited = zero+(uint32_t)(T)-1;
+  quad d[6], gone[6], best[7];
+  uint distance[6];
+  uint64_t i;
+  auto low = [](quad a, quad b) -> quad {return a < b ? a : b;};
+  for (uint c=0; c<7; c++){
+    best[c] = ~zero;
+  }
+  for (i=0; i+4<=n; i+=4){
+    for (uint k=0; k<6; k++){
+      d[k] = (quad){dist[k][i], dist[k][i+1], dist[k][i+2], dist[k][i+3]};
+      gone[k] = (quad)(d[k] == unvisited);
     }
-    if (v->distance[0]!=(uint)-1 && v->distance[2]!=(uint)-1 &&
-        v->distance[3]!=(uint)-1 && v->distance[5]!=(uint)-1){
-      // Find zx size 
-      len  = v->distance[0]+v->distance[2]+v->distance[3]+v->distance[5];
-      if (len < minsizes[5]){
-        minsizes[5]=len;
+    best[0] = low(best[0], (d[0]+d[3]) | gone[0] | gone[3]);
+    best[1] = low(best[1], (d[1]+d[4]) | gone[1] | gone[4]);
+    best[2] = low(best[2], (d[2]+d[5]) | gone[2] | gone[5]);
+    best[3] = low(best[3], (d[0]+d[1]+d[3]+d[4]) |
+      gone[0] | gone[1] | gone[3] | gone[4]);
+    best[4] = low(best[4], (d[1]+d[2]+d[4]+d[5]) |
+      gone[1] | gone[2] | gone[4] | gone[5]);
+    best[5] = low(best[5], (d[0]+d[2]+d[3]+d[5]) |
+      gone[0] | gone[2] | gone[3] | gone[5]);
+    best[6] = low(best[6], (d[0]+d[1]+d[2]+d[3]+d[4]+d[5]) |
+      gone[0] | gone[1] | gone[2] | gone[3] | gone[4] | gone[5]);
+  }
+  for (uint c=0; c<7; c++){
+    for (uint j=0; j<4; j++){
+      minsizes[c] = std::min(minsizes[c], (uint)best[c][j]);
+    }
+  }
+  for (; i<n; i++){
+    for (uint k=0; k<6; k++){
+      distance[k] = (dist[k][i]==(T)-1) ? (uint)-1 : dist[k][i];
+    }
+    crossing(distance, minsizes);
+  }
+}
+
+template void lattice::crossings(const uint16_t* const*, uint64_t, uint*);
+template void lattice::crossings(const uint32_t* const*, uint64_t, uint*);
+
+void lattice::crossing(const uint* distance, uint* minsizes){
+/* Update the smallest crossing clusters with those through a single vertex.
+ * distance : distances of the vertex in each of the six directions, with
+ *            (uint)(-1) for unvisited
+ * minsizes : smallest total distance for each kind of crossing cluster, in
+ *            the order of findCrossings
+ */
+  uint len=-1;
+  if (distance[0]!=(uint)-1 && distance[3]!=(uint)-1){
+    // Find x size
+    len  = distance[0]+distance[3];
+    if (len < minsizes[0]){
+      minsizes[0]=len;
+    }
+  }
+  if (distance[1]!=(uint)-1 && distance[4]!=(uint)-1){
+    // Find y size
+    len  = distance[1]+distance[4];
+    if (len < minsizes[1]){
+      minsizes[1]=len;
+    }
+  }
+  if (distance[2]!=(uint)-1 && distance[5]!=(uint)-1){
+    // Find z size
+    len  = distance[2]+distance[5];
+    if (len < minsizes[2]){
+      minsizes[2]=len;
+    }
+  }
+  if (distance[0]!=(uint)-1 && distance[1]!=(uint)-1 &&
+      distance[3]!=(uint)-1 && distance[4]!=(uint)-1){
+    // Find xy size 
+    len  = distance[0]+distance[1]+distance[3]+distance[4];
+    if (len < minsizes[3]){
+      minsizes[3]=len;
+    }
+  }
+  if (distance[1]!=(uint)-1 && distance[2]!=(uint)-1 &&
+      distance[4]!=(uint)-1 && distance[5]!=(uint)-1){
+    // Find yz size 
+    len  = distance[1]+distance[2]+distance[4]+distance[5];
+    if (len < minsizes[4]){
+      minsizes[4]=len;
+    }
+  }
+  if (distance[0]!=(uint)-1 && distance[2]!=(uint)-1 &&
+      distance[3]!=(uint)-1 && distance[5]!=(uint)-1){
+    // Find zx size 
+    len  = distance[0]+distance[2]+distance[3]+distance[5];
+    if (len < minsizes[5]){
+      minsizes[5]=len;
+    }
+  }
+  if (distance[0]!=(uint)-1 && distance[1]!=(uint)-1 &&
+      distance[2]!=(uint)-1 && distance[3]!=(uint)-1 &&
+      distance[4]!=(uint)-1 && distance[5]!=(uint)-1){
+    // Find xyz size
+    len  = distance[0]+distance[1]+distance[2]+
+           distance[3]+distance[4]+distance[5];
+    if (len < minsizes[6]){
+      minsizes[6]=len;
+    }
+  }
+}
+
+std::vector<bool> lattice::findSpanning(){
+/* Find which crossing clusters exist, without their sizes.
+ * Clusters are labelled with a single union-find pass over the open
+ * bonds, then each cluster records which of the six faces (see faces) it
+ * touches. A cluster crosses in x if it touches both x faces, and so on.
+ * Returns a vector of 7 bools in the same order as findCrossings. Where every
+ * bond can be followed both ways (see graph::symmetric) these are true exactly
+ * where findCrossings returns something other than (uint)(-1). On topologies
+ * with one-way bonds, such as diamond_grid, they may not be: union-find joins
+ * the ends of a bond whichever way it points, while the bfs only follows it
+ * forwards, so a cluster can cross here without a path crossing there
+ */
+  std::vector<bool> spans(7,false);
+  std::vector<unsigned char> touched(size,0);
+  std::vector<uint> roots;
+  uint root;
+  clusters.reset(size);
+  for (uint e=0; e<bonds(); e++){
+    if (mask[e/64]>>(e%64) & 1){
+      clusters.merge(ends[2*e], ends[2*e+1]);
+    }
+  }
+  for (uint d=0; d<6; d++){
+    for (auto idx : faces[d]){
+      root = clusters.find(idx);
+      if (touched[root] == 0){
+        roots.push_back(root);
       }
+      touched[root] |= 1<<d;
     }
-    if (v->distance[0]!=(uint)-1 && v->distance[1]!=(uint)-1 &&
-        v->distance[2]!=(uint)-1 && v->distance[3]!=(uint)-1 &&
-        v->distance[4]!=(uint)-1 && v->distance[5]!=(uint)-1){
-      // Find xyz size
-      len  = v->distance[0]+v->distance[1]+v->distance[2]+
-             v->distance[3]+v->distance[4]+v->distance[5];
-      if (len < minsizes[6]){
-        minsizes[6]=len;
+  }
+  for (auto r : roots){
+    for (uint c=0; c<7; c++){
+      if ((touched[r] & masks[c]) == masks[c]){
+        spans[c] = true;
       }
     }
   }
-  for (uint i=0; i<7; i++){
-    if (minsizes[i] != (uint)-1){
-      minsizes[i]++;
+  return spans;
+}
+
+std::vector<uint64_t> lattice::findSpanning64(){
+/* Find which crossing clusters exist in each of the 64 trials of percolate64.
+ * Reachability from each of the six faces is found for all trials at once.
+ * A vertex reachable from both x faces lies on an x crossing cluster, and so
+ * on, as in findCrossings.
+ * Returns a vector of 7 words in the same order as findCrossings. Bit t of
+ * each word is set if that crossing cluster exists in trial t
+ */
+  std::vector<uint64_t> spans(7,0);
+  uint64_t w;
+  for (uint d=0; d<6; d++){
+    reach[d].resize(size);
+    flood64(faces[d], reach[d].data());
+  }
+  for (uint i=0; i<size; i++){
+    for (uint c=0; c<7; c++){
+      w = ~(uint64_t)0;
+      for (uint d=0; d<6; d++){
+        if (masks[c] & (1<<d)){
+          w &= reach[d][i];
+        }
+      }
+      spans[c] |= w;
     }
   }
-  return minsizes;
+  return spans;
 }
 
 void lattice::print(void){
@@ -320,11 +522,13 @@ void lattice::print(void){
  */
   std::cout << type.label << " lattice of size " << dimx << " x " << dimy <<
     " x " << dimz << std::endl;
-  vertex* v;
+  uint n;
   for (iterator I(type.size, dimx, dimy, dimz); I<size; I++){
-    v = adj+I.index();
-    for (auto u : v->adj){
-      std::cout << v-adj << " -> " << u-adj << std::endl;
+    n = I.index();
+    for (uint s=offsets[n]; s<offsets[n+1]; s++){
+      if (open[n]>>(s-offsets[n]) & 1){
+        std::cout << n << " -> " << nbrs[s] << std::endl;
+      }
     }
     std::cout << std::endl;
   }
@@ -431,7 +635,7 @@ lattice_t::lattice_t(void){
  * Create a new lattice type with 0 vertices in unit cell, no adjacency
  */
   size = 0;
-  adjacency = new std::vector<coord>[size];
+  adjacency = NULL;
   label = "null";
 }
 
@@ -469,11 +673,32 @@ lattice_t::~lattice_t(void){
   delete[] adjacency;
 }
 
-lattice_t lattice_t::operator=(const lattice_t &D){
+lattice_t::lattice_t(lattice_t&& D) noexcept{
+/* Move constructor. Takes over the adjacency of D, leaving it empty, without
+ * allocating anything
+ * D : lattice_t object to move from
+ */
+  size = D.size;
+  adjacency = D.adjacency;
+  D.size = 0;
+  D.adjacency = NULL;
+  startx.swap(D.startx);
+  starty.swap(D.starty);
+  startz.swap(D.startz);
+  endx.swap(D.endx);
+  endy.swap(D.endy);
+  endz.swap(D.endz);
+  label.swap(D.label);
+}
+
+lattice_t& lattice_t::operator=(const lattice_t &D){
 /* Assignment operator.
  * D : lattice_t to copy
  * return self
  */
+  if (this == &D){
+    return *this;
+  }
   delete[] adjacency;
   size = D.size;
   adjacency = new std::vector<coord>[size];
@@ -490,6 +715,24 @@ lattice_t lattice_t::operator=(const lattice_t &D){
   return *this;
 }
 
+lattice_t& lattice_t::operator=(lattice_t&& D) noexcept{
+/* Move assignment operator. Exchanges contents with D, which frees the old
+ * adjacency
+ * D : lattice_t to move from
+ * return self
+ */
+  std::swap(size, D.size);
+  std::swap(adjacency, D.adjacency);
+  startx.swap(D.startx);
+  starty.swap(D.starty);
+  startz.swap(D.startz);
+  endx.swap(D.endx);
+  endy.swap(D.endy);
+  endz.swap(D.endz);
+  label.swap(D.label);
+  return *this;
+}
+
 void lattice_t::add(uint start, int h, int i, int j, int k){
 /* Add new connection to unit cell
  * start : vertex to start on
@@ -519,197 +762,28 @@ void lattice_t::print(void){
 }
 
 //--------------------GENERATOR FUNCTIONS-------------------------------------//
+// The unit cells themselves are in cells.h
 
 lattice_t lattices::cubic(void){
 /* Unit cell for cubic lattice
  */
-  lattice_t D(1, "cubic");
-  D.add(0,0,-1,0,0);
-  D.add(0,0,+1,0,0);
-  D.add(0,0,0,-1,0);
-  D.add(0,0,0,+1,0);
-  D.add(0,0,0,0,-1);
-  D.add(0,0,0,0,+1);
-  D.startx.push_back(0);
-  D.starty.push_back(0);
-  D.startz.push_back(0);
-  D.endx.push_back(0);
-  D.endy.push_back(0);
-  D.endz.push_back(0);
-  return D;
+  return cells::make<cells::cubic>();
 }
 
 lattice_t lattices::raussendorf(void){
 /* Unit cell for raussendorf lattice
  */
-  lattice_t D(6, "raussendorf");
-  D.add(0,1,0,0,0);
-  D.add(0,5,0,0,0);
-  D.add(0,1,0,-1,0);
-  D.add(0,5,0,0,-1);
-  D.starty.push_back(0);
-  D.startz.push_back(0);
-
-  D.add(1,2,0,0,0);
-  D.add(1,0,0,0,0);
-  D.add(1,2,-1,0,0);
-  D.add(1,0,0,1,0);
-  D.startx.push_back(1);
-  D.endy.push_back(1);
-
-  D.add(2,3,0,0,0);
-  D.add(2,1,0,0,0);
-  D.add(2,3,0,0,-1);
-  D.add(2,1,1,0,0);
-  D.startz.push_back(2);
-  D.endx.push_back(2);
-
-  D.add(3,4,0,0,0);
-  D.add(3,2,0,0,0);
-  D.add(3,4,0,1,0);
-  D.add(3,2,0,0,1);
-  D.endy.push_back(3);
-  D.endz.push_back(3);
-
-  D.add(4,5,0,0,0);
-  D.add(4,3,0,0,0);
-  D.add(4,5,1,0,0);
-  D.add(4,3,0,-1,0);
-  D.starty.push_back(4);
-  D.endx.push_back(4);
-
-  D.add(5,0,0,0,0);
-  D.add(5,4,0,0,0);
-  D.add(5,0,0,0,1);
-  D.add(5,4,-1,0,0);
-  D.startx.push_back(5);
-  D.endz.push_back(5);
-  return D;
+  return cells::make<cells::raussendorf>();
 }
 
 lattice_t lattices::diamond(void){
 /* Unit cell for diamond lattice
  */
-  lattice_t D(8, "diamond");
-  D.add(0,1,0,0,0);
-  D.add(0,5,-1,1,0);
-  D.add(0,6,-1,0,1);
-  D.add(0,7,0,1,1);
-  D.startx.push_back(0);
-  D.endy.push_back(0);
-  D.endz.push_back(0);
-
-  D.add(1,0,0,0,0);
-  D.add(1,2,0,0,0);
-  D.add(1,3,0,0,0);
-  D.add(1,4,0,0,0);
-
-  D.add(2,1,0,0,0);
-  D.add(2,5,0,0,0);
-  D.add(2,6,0,0,1);
-  D.add(2,7,0,0,1);
-  D.endz.push_back(2);
-
-  D.add(3,1,0,0,0);
-  D.add(3,5,0,1,0);
-  D.add(3,6,0,0,0);
-  D.add(3,7,0,1,0);
-  D.endy.push_back(3);
-
-  D.add(4,1,0,0,0);
-  D.add(4,5,-1,0,0);
-  D.add(4,6,-1,0,0);
-  D.add(4,7,0,0,0);
-  D.startx.push_back(4);
-
-  D.add(5,0,1,-1,0);
-  D.add(5,2,0,0,0);
-  D.add(5,3,0,-1,0);
-  D.add(5,4,1,0,0);
-  D.starty.push_back(5);
-  D.endx.push_back(5);
-  
-  D.add(6,0,1,0,-1);
-  D.add(6,2,0,0,-1);
-  D.add(6,3,0,0,0);
-  D.add(6,4,1,0,0);
-  D.startz.push_back(6);
-  D.endx.push_back(6);
-  
-  D.add(7,0,0,-1,-1);
-  D.add(7,2,0,0,-1);
-  D.add(7,3,0,-1,0);
-  D.add(7,4,0,0,0);
-  D.starty.push_back(7);
-  D.startz.push_back(7);
-  return D;
+  return cells::make<cells::diamond>();
 }
 
 lattice_t lattices::diamond_grid(void){
-/* Alternative unit cell for diamond lattice. Fits on square grid. Courtesy of
- * Mercedes
- */
-  lattice_t D(8, "diamond (grid)");
-  D.add(0,1,0,0,0);
-  D.add(0,5,0,0,0);
-  D.add(0,5,-1,0,0);
-  D.add(0,6,0,-1,0);
-  D.startx.push_back(0);
-  D.starty.push_back(0);
-
-  D.add(1,0,0,0,0);
-  D.add(1,2,0,0,0);
-  D.add(1,2,0,0,0);
-  D.add(1,7,-1,0,0);
-  D.startx.push_back(1);
-
-  D.add(2,1,0,0,0);
-  D.add(2,3,0,0,0);
-  D.add(2,3,-1,0,0);
-  D.add(2,6,0,0,1);
-  D.startx.push_back(2);
-  D.endz.push_back(2);
-  
-  D.add(3,2,0,0,0);
-  D.add(3,4,0,0,0);
-  D.add(3,2,1,0,0);
-  D.add(3,7,0,1,0);
-  D.endx.push_back(3);
-  D.endy.push_back(3);
-
-  D.add(4,3,0,0,0);
-  D.add(4,5,0,0,0);
-  D.add(4,6,0,0,0);
-  D.add(4,6,1,0,0);
-  D.endx.push_back(4);
-
-  D.add(5,0,0,0,0);
-  D.add(5,4,0,0,0);
-  D.add(5,0,1,0,0);
-  D.add(5,7,0,0,-1);
-  D.endx.push_back(5);
-  D.startz.push_back(5);
-
-  D.add(6,4,0,0,0);
-  D.add(6,0,0,1,0);
-  D.add(6,2,0,0,-1);
-  D.add(6,4,-1,0,0);
-  D.startx.push_back(6);
-  D.startz.push_back(6);
-  D.endy.push_back(6);
-
-  D.add(7,1,0,0,0);
-  D.add(7,1,1,0,0);
-  D.add(7,3,0,-1,0);
-  D.add(7,5,0,0,1);
-  D.starty.push_back(7);
-  D.endx.push_back(7);
-  D.endz.push_back(7);
-
-  return D;
+/* Alternative unit cell for diamond lattice. Fits on square grid
+ */
+  return cells::make<cells::diamond_grid>();
 }
-
-
-
-
-
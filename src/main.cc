@@ -3,16 +3,55 @@
 
 #include <iostream>
 #include <fstream>
+#include <cmath>
 #include <string>
+#include <sstream>
+#include <algorithm>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstring>
 #include <gsl/gsl_rng.h>
 #include <curses.h>
+#include <sys/wait.h>
 
 #include "heads/graph.h"
 #include "heads/lattice.h"
+#include "heads/newmanziff.h"
+#include "heads/pool.h"
+#include "heads/probe.h"
+#include "heads/results.h"
+#include "heads/shard.h"
 #include "heads/main.h"
 
 int main(int argc, char** argv){
-  return test(argc, argv);
+/* Runs the driver named by the first argument on the rest of them, as in
+ * "percolate run 314 8". "percolate work <socket>" is a worker for a sharded
+ * sweep (see sharded). With no arguments, runs test
+ */
+  const std::pair<std::string, int (*)(int, char**)> drivers[] = {
+    {"test", test}, {"run", run}, {"coupled", coupled}, {"adapt", adapt},
+    {"batch", batch}, {"shard", sharded}, {"span", span}, {"sweep", sweep}};
+
+  if (argc<2){
+    return test(argc, argv);
+  }
+  if (std::string(argv[1]) == "work"){
+    return sharded(argc, argv);
+  }
+  for (auto& d : drivers){
+    if (d.first == argv[1]){
+      return d.second(argc-1, argv+1);
+    }
+  }
+  std::cerr << "usage: " << argv[0] << " [driver [args]] or " << argv[0] <<
+    " work <socket>" << std::endl << "drivers:";
+  for (auto& d : drivers){
+    std::cerr << " " << d.first;
+  }
+  std::cerr << std::endl;
+  return 1;
 }
 
 int test(int argc, char** argv){
@@ -24,73 +63,381 @@ int test(int argc, char** argv){
   return 0;
 }
 
+void trial(lattice* L, double p, uint seed, uint t, bool lengths,
+    uint* sizes){
+/* Run a single trial: percolate L, then find the smallest 1D, 2D and 3D
+ * crossing clusters. The result only depends on p, seed and t, so any trial
+ * of a run can be replayed on its own.
+ * L       : lattice to use. Its previous state is irrelevant
+ * p       : probability of forming bonds
+ * seed    : seed value for rng
+ * t       : trial number
+ * lengths : if false, only find whether crossing clusters exist
+ * sizes   : set to the 1D, 2D and 3D sizes. (uint)(-1) if there is no such
+ *           cluster, 0 if there is one but lengths is false
+ */
+  uint minsizes[7];
+  std::vector<bool> spans;
+  probe::timer drawing(probe::percolate);
+  L->percolate(p, seed, t);
+  drawing.stop();
+  if (lengths){
+    probe::timer searching(probe::traverse);
+    L->reset();
+    L->traverse();
+    searching.stop();
+    probe::timer scanning(probe::crossings);
+    L->crossings(minsizes);
+  }
+  else{
+    probe::timer spanning(probe::crossings);
+    spans=L->findSpanning();
+    for (uint k=0; k<7; k++){
+      minsizes[k] = spans[k] ? 0 : (uint)-1;
+    }
+  }
+  sizes[0]=std::min(minsizes[0],std::min(minsizes[1],minsizes[2]));
+  sizes[1]=std::min(minsizes[3],std::min(minsizes[4],minsizes[5]));
+  sizes[2]=minsizes[6];
+  if (probe::on && probe::active){
+    probe::active->trials++;
+  }
+}
+
+void climb(lattice* L, const std::vector<double>& ps, uint seed, uint t,
+    uint* sizes){
+/* Run a single trial at every p at once. Bonds are only added as p rises (see
+ * graph::couple), so the distances are found once with every bond closed and
+ * then repaired at each p. At each p the result is the same as trial would
+ * give for the same seed and t.
+ * L     : lattice to use. Its previous state is irrelevant
+ * ps    : probabilities of forming bonds, in increasing order
+ * seed  : seed value for rng
+ * t     : trial number
+ * sizes : set to the 1D, 2D and 3D sizes at each p in turn, as for trial
+ */
+  uint minsizes[7];
+  L->couple(seed, t);
+  L->reset();
+  L->traverse();
+  for (uint j=0; j<ps.size(); j++){
+    L->raise(ps[j]);
+    L->repair();
+    L->crossings(minsizes);
+    sizes[3*j]=std::min(minsizes[0],std::min(minsizes[1],minsizes[2]));
+    sizes[3*j+1]=std::min(minsizes[3],std::min(minsizes[4],minsizes[5]));
+    sizes[3*j+2]=minsizes[6];
+  }
+}
+
 int run(int argc, char** argv){
   lattice_t c = lattices::diamond();
-  lattice L;
-  uint nreps=5000, dim=8, seed=314,
-    size1d, size2d, size3d,
-    n1d=0, n2d=0, n3d=0,
-    sumsizes1d=0, sumsizes2d=0, sumsizes3d=0;
-  double pmin=0.2, pmax=0.6, pincr=0.005,
-    mean1d, mean2d, mean3d, p1d, p2d, p3d;
-  std::vector<uint> minsizes;
+  uint nreps=5000, dim=8, seed=314, nthreads=0;
+  double pmin=0.2, pmax=0.6, pincr=0.005;
+  bool lengths=true;  // If false, only find whether crossings exist (by
+                      // union-find) and report NaN for the mean lengths
+  std::vector<double> ps;
+  std::vector<uint> sizes, todo;
+  std::vector<probe> probes;  // Per point and worker, if compiled with PROBE
+  probe setup;
   std::ofstream fout("out.dat");
-  gsl_rng *r=gsl_rng_alloc(gsl_rng_mt19937);
 
   if (argc>1){
     seed=atoi(argv[1]);
   }
-  gsl_rng_set(r, seed);
+  if (argc>2){
+    nthreads=atoi(argv[2]); // Zero for one per core
+  }
+  if (argc>3){
+    lengths=atoi(argv[3]);  // Zero for whether crossings exist only
+  }
+  probe::active = &setup;
+  probe::timer building(probe::construct);
+  lattice L(c,dim,dim,dim); // Topology is built once and reused every trial
+  building.stop();
 
-  std::cout << "# " << dim << "x" << dim << "x" << dim << " " << c.label <<
-    " lattice" << std::endl;
-  std::cout << "# " << nreps << " trials per point" << std::endl;
-  std::cout << "# " << "seed " << seed << std::endl;
-  std::cout << "# p p_x1d p_x2d p_x3d <l_1d> <l_2d> <l_3d>" << std::endl;
+  uint dims[3] = {dim, dim, dim};
+  std::ostringstream what;
+  what << nreps << " trials per point";
+  header(std::cout, c.label, dims, what.str(), seed);
+  header(fout, c.label, dims, what.str(), seed);
 
-  fout << "# " << dim << "x" << dim << "x" << dim << " " << c.label << 
-    " lattice" << std::endl;
-  fout << "# " << nreps << " trials per point" << std::endl;
-  fout << "# " << "seed " << seed << std::endl;
-  fout << "# p p_x1d p_x2d p_x3d <l_1d> <l_2d> <l_3d>" << std::endl;
+  // Trial t is repetition t%nreps at ps[t/nreps]. Its bonds are drawn from the
+  // stream for (seed, t), so the output does not depend on which thread runs
+  // which trial
+  for (double p=pmin; p<(pmax+pincr/2.); p+=pincr){
+    ps.push_back(p);
+  }
+  sizes.resize(3*ps.size()*nreps);
+  // Every trial is kept in out.bin as it finishes. If the job is killed and
+  // started again, the trials already there are read back rather than rerun.
+  // Without out.bin nothing is started; if it fails part way, the sweep is
+  // finished anyway, since every trial is still in memory
+  std::unique_ptr<results> R;
+  try{
+    R.reset(new results("out.bin", c.label, dims, seed, nreps, ps, lengths,
+      sizes.data()));
+  }
+  catch (const std::system_error& e){
+    std::cerr << "run: " << e.what() << std::endl;
+    return 1;
+  }
+  for (uint t=0; t<ps.size()*nreps; t++){
+    if (!R->has(t)){
+      todo.push_back(t);
+    }
+  }
+  if (todo.size() < ps.size()*nreps){
+    std::cout << "# resuming with " << ps.size()*nreps-todo.size() <<
+      " trials done" << std::endl;
+  }
+  pool P(nthreads);
+  std::vector<lattice> work(P.threads(), L); // One workspace per thread
+  probes.resize(probe::on ? ps.size()*P.threads() : 0);
+  P.run(todo.size(), [&](uint k, uint w){
+    uint t = todo[k];
+    if (probe::on){
+      probe::active = &probes[t/nreps*P.threads()+w];
+    }
+    trial(&work[w], ps[t/nreps], seed, t, lengths, &sizes[3*t]);
+    R->put(t, &sizes[3*t]);
+  });
+  probe::active = NULL;
+  if (!R->close()){
+    std::cerr << "run: cannot write out.bin (" << strerror(R->error()) <<
+      "), so it does not hold every trial below" << std::endl;
+  }
+
+  if (probe::on){
+    // The construction time on the first line, then one line per point
+    std::ofstream jout("out.jsonl");
+    setup.write(jout);
+    for (uint j=0; j<ps.size(); j++){
+      probe sum;
+      for (uint w=0; w<P.threads(); w++){
+        sum.add(probes[j*P.threads()+w]);
+      }
+      sum.write(jout, ps[j]);
+    }
+  }
+
+  tabulate(ps, nreps, sizes.data(), std::cout, lengths);
+  tabulate(ps, nreps, sizes.data(), fout, lengths);
+
+  fout.close();
+
+  return 0;
+}
+
+int coupled(int argc, char** argv){
+/* Same output as run(), but each repetition is one trial raised through every
+ * p (see climb), rather than a fresh trial at each p. Points are no longer
+ * independent of each other, but each point on its own has the same
+ * distribution as before
+ */
+  lattice_t c = lattices::diamond();
+  uint nreps=5000, dim=8, seed=314, nthreads=0;
+  double pmin=0.2, pmax=0.6, pincr=0.005;
+  std::vector<double> ps;
+  std::vector<uint> sizes, bypoint;
+  std::ofstream fout("out.dat");
+
+  if (argc>1){
+    seed=atoi(argv[1]);
+  }
+  if (argc>2){
+    nthreads=atoi(argv[2]); // Zero for one per core
+  }
+  lattice L(c,dim,dim,dim);
 
+  uint dims[3] = {dim, dim, dim};
+  std::ostringstream what;
+  what << nreps << " coupled trials";
+  header(std::cout, c.label, dims, what.str(), seed);
+  header(fout, c.label, dims, what.str(), seed);
+
+  // Trial i covers every p, and its sizes at ps[j] are at 3*(i*ps.size()+j)
   for (double p=pmin; p<(pmax+pincr/2.); p+=pincr){
-    sumsizes1d=sumsizes2d=sumsizes3d=0;
-    n1d=n2d=n3d=0;
-    for (uint i=0; i<nreps; i++){
-      L = lattice(c,dim,dim,dim);
-      L.percolate(p, gsl_rng_get(r));
-      L.traverse();
-      minsizes=L.findCrossings();
-
-      size1d=std::min(minsizes[0],std::min(minsizes[1],minsizes[2]));
-      size2d=std::min(minsizes[3],std::min(minsizes[4],minsizes[5]));
-      size3d=minsizes[6];
-
-      if (size1d != (uint)-1){
-        sumsizes1d+=size1d;
-        n1d++;
+    ps.push_back(p);
+  }
+  sizes.resize(3*ps.size()*nreps);
+  pool P(nthreads);
+  std::vector<lattice> work(P.threads(), L); // One workspace per thread
+  P.run(nreps, [&](uint t, uint w){
+    climb(&work[w], ps, seed, t, &sizes[3*t*ps.size()]);
+  });
+
+  // Rearranged into the order of run() to tabulate: repetition i at ps[j] at
+  // 3*(j*nreps+i)
+  bypoint.resize(sizes.size());
+  for (uint i=0; i<nreps; i++){
+    for (uint j=0; j<ps.size(); j++){
+      std::copy(&sizes[3*(i*ps.size()+j)], &sizes[3*(i*ps.size()+j)+3],
+        &bypoint[3*(j*nreps+i)]);
+    }
+  }
+  tabulate(ps, nreps, bypoint.data(), std::cout);
+  tabulate(ps, nreps, bypoint.data(), fout);
+
+  fout.close();
+
+  return 0;
+}
+
+uint bisect(lattice* L, uint seed, uint t, double tol, double* pstar){
+/* Find the p at which a 1D, 2D and 3D crossing cluster first appears in a
+ * single trial. As p rises the bonds of a trial are only ever added (see
+ * graph::couple), so whether a crossing exists is monotone in p and can be
+ * bisected. The three brackets are narrowed together: each step tests the
+ * middle of the widest one, and the answer narrows every bracket it falls in.
+ * L     : lattice to use. Its previous state is irrelevant
+ * seed  : seed value for rng
+ * t     : trial number
+ * tol   : width to narrow each bracket to
+ * pstar : set to the middle of the final bracket for 1D, 2D and 3D
+ * returns the number of values of p tested
+ */
+  double lo[3]={0,0,0}, hi[3]={1,1,1}, mid;
+  std::vector<bool> spans;
+  bool crosses[3];
+  uint k, n=0;
+  while (true){
+    k = 0;
+    for (uint d=1; d<3; d++){
+      if (hi[d]-lo[d] > hi[k]-lo[k]){
+        k = d;
       }
-      if (size2d != (uint)-1){
-        sumsizes2d+=size2d;
-        n2d++;
+    }
+    if (hi[k]-lo[k] <= tol){
+      break;
+    }
+    mid = (lo[k]+hi[k])/2;
+    L->percolate(mid, seed, t);
+    spans = L->findSpanning();
+    n++;
+    crosses[0] = spans[0] || spans[1] || spans[2];
+    crosses[1] = spans[3] || spans[4] || spans[5];
+    crosses[2] = spans[6];
+    for (uint d=0; d<3; d++){
+      if (mid > lo[d] && mid < hi[d]){
+        if (crosses[d]){
+          hi[d] = mid;
+        }
+        else{
+          lo[d] = mid;
+        }
       }
-      if (size3d != (uint)-1){
-        sumsizes3d+=size3d;
-        n3d++;
+    }
+  }
+  for (uint d=0; d<3; d++){
+    pstar[d] = (lo[d]+hi[d])/2;
+  }
+  return n;
+}
+
+int adapt(int argc, char** argv){
+/* Estimate p_c for 1D, 2D and 3D crossing clusters, as the p at which they
+ * exist in half of all trials. Rather than running a fixed grid of p, each
+ * trial finds the p at which its crossing clusters appear (see bisect), so
+ * every test is spent close to where that trial crosses. p_c is the median of
+ * these, with a distribution-free confidence interval from order statistics.
+ * Trials are added in batches until every interval is narrow enough.
+ * Takes the seed, the number of threads (zero for one per core), the size of
+ * the lattice, the width wanted and the most trials to run
+ */
+  lattice_t c = lattices::diamond();
+  uint dim=8, seed=314, nthreads=0, batch=1000, maxtrials=1000000,
+    nreps=5000, npoints=0, ntrials=0, ntests=0, lo, hi;
+  double width=0.002, z=1.96,   // Wanted width of the 95% intervals
+    pmin=0.2, pmax=0.6, pincr=0.005,
+    pc[3], plo[3], phi[3];
+  bool narrow=false;
+  std::vector<double> pstars, sorted;
+  std::vector<uint> tests;
+  std::ofstream fout("out.dat");
+
+  if (argc>1){
+    seed=atoi(argv[1]);
+  }
+  if (argc>2){
+    nthreads=atoi(argv[2]); // Zero for one per core
+  }
+  if (argc>3){
+    dim=atoi(argv[3]);
+  }
+  if (argc>4){
+    width=atof(argv[4]);
+  }
+  if (argc>5){
+    maxtrials=std::max(1, atoi(argv[5]));
+  }
+  lattice L(c,dim,dim,dim);
+
+  uint dims[3] = {dim, dim, dim};
+  std::ostringstream what;
+  what << "adaptive, 95% intervals of width " << width;
+  header(std::cout, c.label, dims, what.str(), seed, "d p_c lo hi");
+  header(fout, c.label, dims, what.str(), seed, "d p_c lo hi");
+
+  // Trial t uses the stream for (seed, t), so the trials in each batch and the
+  // point at which it stops do not depend on the number of threads
+  pool P(nthreads);
+  std::vector<lattice> work(P.threads(), L); // One workspace per thread
+  while (!narrow && ntrials < maxtrials){
+    batch = std::min(batch, maxtrials-ntrials); // The last may be cut short
+    pstars.resize(3*(ntrials+batch));
+    tests.resize(ntrials+batch);
+    P.run(batch, [&](uint k, uint w){
+      uint t = ntrials+k;
+      tests[t] = bisect(&work[w], seed, t, width/16, &pstars[3*t]);
+    });
+    ntrials += batch;
+    narrow = true;
+    for (uint d=0; d<3; d++){
+      sorted.clear();
+      for (uint t=0; t<ntrials; t++){
+        sorted.push_back(pstars[3*t+d]);
       }
+      std::sort(sorted.begin(), sorted.end());
+      // Ranks bounding the median: the number of trials below it is
+      // binomial(ntrials, 1/2)
+      lo = (uint)std::max(0., std::floor((ntrials-z*std::sqrt(ntrials))/2));
+      hi = (uint)std::min(ntrials-1.,
+        std::ceil((ntrials+z*std::sqrt(ntrials))/2));
+      pc[d] = sorted[ntrials/2];
+      plo[d] = sorted[lo];
+      phi[d] = sorted[hi];
+      narrow = narrow && (phi[d]-plo[d] <= width);
     }
-    p1d=n1d/(double)nreps;
-    p2d=n2d/(double)nreps;
-    p3d=n3d/(double)nreps;
-    mean1d=sumsizes1d/(double)n1d;
-    mean2d=sumsizes2d/(double)n2d;
-    mean3d=sumsizes3d/(double)n3d;
-  
-    std::cout << p << " " << p1d << " " << p2d << " " << p3d << " " <<
-      mean1d << " " << mean2d << " " << mean3d << std::endl;
-    fout << p << " " << p1d << " " << p2d << " " << p3d << " " <<
-      mean1d << " " << mean2d << " " << mean3d << std::endl;
+  }
+  for (uint t=0; t<ntrials; t++){
+    ntests += tests[t];
+  }
+  for (double p=pmin; p<(pmax+pincr/2.); p+=pincr){
+    npoints++;
+  }
+
+  for (uint d=0; d<3; d++){
+    std::cout << d+1 << " " << pc[d] << " " << plo[d] << " " << phi[d] <<
+      std::endl;
+    fout << d+1 << " " << pc[d] << " " << plo[d] << " " << phi[d] << std::endl;
+  }
+  // Each test is one percolate and findSpanning, the same work as a trial of
+  // run() with lengths off (existence only). Trials with lengths do a bfs as
+  // well, so cost more than a test
+  std::cout << "# " << ntrials << " trials, " << ntests << " tests of p, " <<
+    "against " << npoints*nreps << " existence-only trials for the grid of " <<
+    "run() (" << 100.*ntests/(npoints*nreps) << "% as many)" <<
+    std::endl;
+  fout << "# " << ntrials << " trials, " << ntests << " tests of p, " <<
+    "against " << npoints*nreps << " existence-only trials for the grid of " <<
+    "run() (" << 100.*ntests/(npoints*nreps) << "% as many)" <<
+    std::endl;
+  if (!narrow){
+    std::cout << "# stopped at " << ntrials << " trials before reaching " <<
+      "the width wanted" << std::endl;
+    fout << "# stopped at " << ntrials << " trials before reaching " <<
+      "the width wanted" << std::endl;
   }
 
   fout.close();
@@ -98,3 +445,416 @@ int run(int argc, char** argv){
   return 0;
 }
 
+int batch(int argc, char** argv){
+/* Same output as run(), for a list of jobs read from a file, one per line:
+ *   cell dimx dimy dimz pmin pmax pincr nreps
+ * where cell is cubic, raussendorf, diamond or diamond_grid, and lines
+ * starting with # are skipped. Each job is costed from the vertices and bonds
+ * of its lattice and the number of trials. The trials of every job go into a
+ * single queue, most expensive job first, which all the threads take from.
+ * The big sizes which used to finish last now start first, with every thread
+ * on them, and the small ones fill in at the end without any thread waiting
+ * for the others to finish a job.
+ * The unit cells are built once and shared by every job using them. The
+ * lattice of each job is built when its first trial is taken, copied by the
+ * threads running it, and freed when its last trial is done, so only the jobs
+ * in flight, at most one per thread, hold a lattice at any time.
+ */
+  class job{
+  /* A sweep over p for one lattice
+   */
+    public:
+      uint cell;              // Index into the unit cells
+      uint dims[3];           // Dimensions of the lattice
+      double pmin, pmax, pincr;
+      uint nreps;             // Trials per point
+      double cost;            // Estimated cost, in vertices and bonds visited
+  };
+  const char* names[4] = {"cubic", "raussendorf", "diamond", "diamond_grid"};
+  std::vector<lattice_t> cells = {lattices::cubic(), lattices::raussendorf(),
+    lattices::diamond(), lattices::diamond_grid()};
+  uint seed=314, nthreads=0, cellbonds, npoints;
+  std::string file="jobs.txt", line, name;
+  std::vector<job> jobs;
+  std::vector<std::unique_ptr<lattice>> Ls;
+                                    // Lattice of each job while it runs
+  std::mutex built;                 // Guards Ls
+  std::vector<std::vector<double>> ps;
+                                    // Values of p of each job
+  std::vector<std::vector<uint>> sizes;
+                                    // 3 sizes per trial of each job
+  std::vector<uint> first(1, 0);    // First unit of each job, then the total
+  std::atomic<uint> next(0);        // Next unit to run
+  std::ofstream fout("out.dat");
+  job J;
+
+  if (argc>1){
+    file=argv[1];
+  }
+  if (argc>2){
+    seed=atoi(argv[2]);
+  }
+  if (argc>3){
+    nthreads=atoi(argv[3]); // Zero for one per core
+  }
+  std::ifstream fin(file.c_str());
+  if (!fin){
+    std::cerr << "batch: cannot read " << file << std::endl;
+    return 1;
+  }
+  while (std::getline(fin, line)){
+    std::istringstream in(line);
+    if (!(in >> name) || name[0] == '#'){
+      continue;
+    }
+    J.cell = std::find(names, names+4, name)-names;
+    if (J.cell == 4 || !(in >> J.dims[0] >> J.dims[1] >> J.dims[2] >> J.pmin >>
+        J.pmax >> J.pincr >> J.nreps) || J.pincr <= 0){
+      std::cerr << "batch: cannot read job \"" << line << "\"" << std::endl;
+      return 1;
+    }
+    // Each trial percolates every bond, then searches and scans the vertices
+    cellbonds = 0;
+    for (uint i=0; i<cells[J.cell].size; i++){
+      cellbonds += cells[J.cell].adjacency[i].size();
+    }
+    npoints = 0;
+    for (double p=J.pmin; p<(J.pmax+J.pincr/2.); p+=J.pincr){
+      npoints++;
+    }
+    J.cost = (double)J.dims[0]*J.dims[1]*J.dims[2]*
+      (cells[J.cell].size+cellbonds/2.)*npoints*J.nreps;
+    jobs.push_back(J);
+  }
+  std::stable_sort(jobs.begin(), jobs.end(), [](const job& a, const job& b){
+    return a.cost > b.cost;
+  });
+
+  ps.resize(jobs.size());
+  sizes.resize(jobs.size());
+  Ls.resize(jobs.size());
+  for (uint j=0; j<jobs.size(); j++){
+    job& J = jobs[j];
+    for (double p=J.pmin; p<(J.pmax+J.pincr/2.); p+=J.pincr){
+      ps[j].push_back(p);
+    }
+    sizes[j].resize(3*ps[j].size()*J.nreps);
+    first.push_back(first.back()+ps[j].size()*J.nreps);
+  }
+  std::vector<std::atomic<uint>> left(jobs.size());
+                                    // Trials of each job not yet done
+  for (uint j=0; j<jobs.size(); j++){
+    left[j] = first[j+1]-first[j];
+  }
+
+  // Unit u is trial u-first[j] of the job j with first[j] <= u < first[j+1].
+  // Trials are numbered within each job as in run(), so a job gives the same
+  // results as run() would for the same lattice and seed, whichever thread
+  // runs it. Each thread keeps one workspace, copied from the lattice of the
+  // job it is on when it moves to the next, and drops it when the queue runs
+  // out, so the lattice of a job goes once its last trial is done and every
+  // thread has moved on
+  pool P(nthreads);
+  std::vector<lattice> work(P.threads());
+  std::cout << "# " << jobs.size() << " jobs, most expensive first, on " <<
+    P.threads() << " threads" << std::endl;
+  P.run(P.threads(), [&](uint, uint w){
+    uint j=jobs.size(), t;          // Job of the workspace, none yet
+    for (uint u=next++; u<first.back(); u=next++){
+      if (j == jobs.size() || u >= first[j+1]){
+        j = std::upper_bound(first.begin(), first.end(), u)-first.begin()-1;
+        std::lock_guard<std::mutex> guard(built);
+        if (!Ls[j]){
+          Ls[j].reset(new lattice(cells[jobs[j].cell], jobs[j].dims[0],
+            jobs[j].dims[1], jobs[j].dims[2]));
+        }
+        work[w] = *Ls[j];
+      }
+      t = u-first[j];
+      trial(&work[w], ps[j][t/jobs[j].nreps], seed, t, true, &sizes[j][3*t]);
+      if (--left[j] == 0){
+        std::lock_guard<std::mutex> guard(built);
+        Ls[j].reset();
+      }
+    }
+    work[w] = lattice();
+  });
+
+  for (uint j=0; j<jobs.size(); j++){
+    job& J = jobs[j];
+    lattice_t& c = cells[J.cell];
+    std::ostringstream what;
+    what << J.nreps << " trials per point, estimated cost " << J.cost;
+    header(std::cout, c.label, J.dims, what.str(), seed);
+    header(fout, c.label, J.dims, what.str(), seed);
+    tabulate(ps[j], J.nreps, sizes[j].data(), std::cout);
+    tabulate(ps[j], J.nreps, sizes[j].data(), fout);
+    fout << std::endl;
+  }
+
+  fout.close();
+
+  return 0;
+}
+
+void header(std::ostream& out, const std::string& label, const uint* dims,
+    const std::string& what, uint seed, const std::string& columns){
+/* Write the comment lines heading the output of a driver
+ * out     : stream to write to
+ * label   : name of the unit cell
+ * dims    : dimensions of the lattice
+ * what    : what was run, as in "5000 trials per point"
+ * seed    : seed value for rng
+ * columns : names of the columns of the table which follows
+ */
+  out << "# " << dims[0] << "x" << dims[1] << "x" << dims[2] << " " << label <<
+    " lattice" << std::endl;
+  out << "# " << what << std::endl;
+  out << "# " << "seed " << seed << std::endl;
+  out << "# " << columns << std::endl;
+}
+
+void row(std::ostream& out, double p, const double* cross,
+    const double* mean){
+/* Write one line of the table of run()
+ * out   : stream to write to
+ * p     : probability of forming bonds
+ * cross : probabilities of a 1D, 2D and 3D crossing cluster
+ * mean  : mean lengths of the 1D, 2D and 3D crossings, NaN if not measured
+ */
+  out << p << " " << cross[0] << " " << cross[1] << " " << cross[2] << " " <<
+    mean[0] << " " << mean[1] << " " << mean[2] << std::endl;
+}
+
+void tabulate(const std::vector<double>& ps, uint nreps, const uint* sizes,
+    std::ostream& out, bool lengths){
+/* Write the crossing probabilities and mean sizes at each p, in the format
+ * of run()
+ * ps      : values of p
+ * nreps   : number of trials per point
+ * sizes   : 3 sizes per trial as set by trial, trial t being repetition
+ *           t%nreps at ps[t/nreps]
+ * out     : stream to write to
+ * lengths : whether sizes holds lengths. If not, the means are NaN
+ */
+  uint n, sum;
+  double cross[3], mean[3];
+  for (uint j=0; j<ps.size(); j++){
+    for (uint d=0; d<3; d++){
+      n = sum = 0;
+      for (uint i=0; i<nreps; i++){
+        if (sizes[3*(j*nreps+i)+d] != (uint)-1){
+          sum += sizes[3*(j*nreps+i)+d];
+          n++;
+        }
+      }
+      cross[d] = n/(double)nreps;
+      mean[d] = lengths ? sum/(double)n : NAN;
+    }
+    row(out, ps[j], cross, mean);
+  }
+}
+
+int sharded(int argc, char** argv){
+/* Same output as run(), with the trials spread over several processes (see
+ * shard). Run with "work" as the first argument to be a worker, taking the
+ * path of the socket as the second. Otherwise this is the coordinator, which
+ * takes the seed, the number of workers to start itself (zero for one per
+ * core) and the path of the socket. More workers, from the same binary (as
+ * "percolate work <socket>"), can join at any time, and any of them can be
+ * killed without changing the output. Workers name the sweep by the label and
+ * dimensions of their lattice, and are refused if it is not the
+ * coordinator's. The coordinator fails if every worker it started has gone
+ * and no other is connected while there are trials left.
+ */
+  lattice_t c = lattices::diamond();
+  uint nreps=5000, dim=8, seed=314, nworkers=0, unitsize=100;
+  double pmin=0.2, pmax=0.6, pincr=0.005;
+  std::string sock="percolate.sock";
+  std::vector<double> ps;
+  std::vector<uint> sizes;
+  std::vector<shard::unit> units;
+  std::vector<pid_t> children;
+  std::ostringstream sweep;         // Name of the sweep, from the lattice
+  shard::unit u;
+
+  sweep << c.label << " " << dim << "x" << dim << "x" << dim;
+  if (argc>1 && std::string(argv[1]) == "work"){
+    if (argc>2){
+      sock=argv[2];
+    }
+    lattice L(c,dim,dim,dim);
+    return shard::work(sock, sweep.str(), [&](const shard::unit& u,
+        uint* sizes){
+      for (uint k=0; k<u.count; k++){
+        trial(&L, u.p, u.seed, u.first+k, true, sizes+3*k);
+      }
+    }) ? 0 : 1;
+  }
+  if (argc>1){
+    seed=atoi(argv[1]);
+  }
+  if (argc>2){
+    nworkers=atoi(argv[2]);
+  }
+  if (argc>3){
+    sock=argv[3];
+  }
+  if (nworkers == 0){
+    nworkers = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // Trial t is repetition t%nreps at ps[t/nreps], as in run(). Units are runs
+  // of up to unitsize repetitions at one point
+  for (double p=pmin; p<(pmax+pincr/2.); p+=pincr){
+    ps.push_back(p);
+  }
+  sizes.resize(3*ps.size()*nreps);
+  u.seed = seed;
+  for (uint j=0; j<ps.size(); j++){
+    for (uint i=0; i<nreps; i+=unitsize){
+      u.id = units.size();
+      u.first = j*nreps+i;
+      u.count = std::min(unitsize, nreps-i);
+      u.p = ps[j];
+      units.push_back(u);
+    }
+  }
+  shard S(sock, sweep.str());
+  for (uint k=0; k<nworkers; k++){
+    pid_t pid = fork();
+    if (pid == 0){
+      char work[] = "work";
+      char* args[3] = {argv[0], work, &sock[0]};
+      _exit(sharded(3, args));
+    }
+    children.push_back(pid);
+  }
+  if (!S.serve(units, sizes.data(), &children)){
+    std::cerr << "sharded: every worker has gone with trials left" <<
+      std::endl;
+    return 1;
+  }
+  for (auto pid : children){
+    waitpid(pid, NULL, 0);
+  }
+
+  std::ofstream fout("out.dat");
+  uint dims[3] = {dim, dim, dim};
+  std::ostringstream what;
+  what << nreps << " trials per point";
+  header(std::cout, c.label, dims, what.str(), seed);
+  header(fout, c.label, dims, what.str(), seed);
+  tabulate(ps, nreps, sizes.data(), std::cout);
+  tabulate(ps, nreps, sizes.data(), fout);
+  fout.close();
+
+  return 0;
+}
+
+int span(int argc, char** argv){
+/* Same output as run() (without the mean lengths), but trials are run 64 at a
+ * time, one per bit of a machine word (see graph::percolate64). Trials are
+ * numbered as in run(), so each one has the same bonds as it does there
+ */
+  lattice_t c = lattices::diamond();
+  uint nreps=5000, dim=8, seed=314, nthreads=0, nblocks, n;
+  double pmin=0.2, pmax=0.6, pincr=0.005,
+    cross[3], none[3]={NAN, NAN, NAN};
+  std::vector<double> ps;
+  std::vector<uint64_t> spans;
+  std::ofstream fout("out.dat");
+
+  if (argc>1){
+    seed=atoi(argv[1]);
+  }
+  if (argc>2){
+    nthreads=atoi(argv[2]); // Zero for one per core
+  }
+  lattice L(c,dim,dim,dim);
+
+  uint dims[3] = {dim, dim, dim};
+  std::ostringstream what;
+  what << nreps << " trials per point";
+  header(std::cout, c.label, dims, what.str(), seed);
+  header(fout, c.label, dims, what.str(), seed);
+
+  // Task t is block t%nblocks of 64 repetitions at ps[t/nblocks]: bit k is
+  // repetition 64*(t%nblocks)+k, trial number (t/nblocks)*nreps plus that.
+  // The last block at each point only counts the trials needed to make nreps
+  for (double p=pmin; p<(pmax+pincr/2.); p+=pincr){
+    ps.push_back(p);
+  }
+  nblocks = (nreps+63)/64;
+  spans.resize(3*ps.size()*nblocks);
+  pool P(nthreads);
+  std::vector<lattice> work(P.threads(), L); // One workspace per thread
+  P.run(ps.size()*nblocks, [&](uint t, uint w){
+    uint used = std::min(64u, nreps-64*(t%nblocks));
+    uint64_t keep = (used == 64) ? ~(uint64_t)0 : ((uint64_t)1<<used)-1;
+    std::vector<uint64_t> m;
+    work[w].percolate64(ps[t/nblocks], seed,
+      t/nblocks*nreps+64*(t%nblocks));
+    m = work[w].findSpanning64();
+    spans[3*t] = (m[0] | m[1] | m[2]) & keep;
+    spans[3*t+1] = (m[3] | m[4] | m[5]) & keep;
+    spans[3*t+2] = m[6] & keep;
+  });
+
+  for (uint j=0; j<ps.size(); j++){
+    for (uint d=0; d<3; d++){
+      n = 0;
+      for (uint b=0; b<nblocks; b++){
+        n += __builtin_popcountll(spans[3*(j*nblocks+b)+d]);
+      }
+      cross[d] = n/(double)nreps;
+    }
+    row(std::cout, ps[j], cross, none);
+    row(fout, ps[j], cross, none);
+  }
+
+  fout.close();
+
+  return 0;
+}
+
+int sweep(int argc, char** argv){
+/* Same output as run() (without the mean lengths), but each trial is a single
+ * Newman-Ziff sweep over the bonds which covers every p at once
+ */
+  lattice_t c = lattices::diamond();
+  uint nreps=5000, dim=8, seed=314;
+  double pmin=0.2, pmax=0.6, pincr=0.005,
+    cross[3], none[3]={NAN, NAN, NAN};
+  std::ofstream fout("out.dat");
+  gsl_rng *r=gsl_rng_alloc(gsl_rng_mt19937);
+
+  if (argc>1){
+    seed=atoi(argv[1]);
+  }
+  gsl_rng_set(r, seed);
+  newmanziff NZ(lattice(c,dim,dim,dim));
+
+  uint dims[3] = {dim, dim, dim};
+  std::ostringstream what;
+  what << nreps << " Newman-Ziff sweeps";
+  header(std::cout, c.label, dims, what.str(), seed);
+  header(fout, c.label, dims, what.str(), seed);
+
+  for (uint i=0; i<nreps; i++){
+    NZ.trial(gsl_rng_get(r));
+  }
+
+  for (double p=pmin; p<(pmax+pincr/2.); p+=pincr){
+    for (uint d=0; d<3; d++){
+      cross[d]=NZ.crossing(d, p);
+    }
+    row(std::cout, p, cross, none);
+    row(fout, p, cross, none);
+  }
+
+  fout.close();
+  gsl_rng_free(r);
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+/* newmanziff.cc
+ * Newman-Ziff class
+ * - Microcanonical sweep: bonds are added one by one in random order
+ * - Crossing probabilities for any p by convolution with the binomial
+ *   distribution of the number of open bonds
+ */
+
+#include "heads/newmanziff.h"
+
+newmanziff::newmanziff(const lattice& L){
+/* Constructor. Copies the bond list and face membership out of L, which is not
+ * needed afterwards.
+ * L : lattice to sweep over
+ */
+  nvert = L.vertices();
+  nbond = L.bonds();
+  ntrials = 0;
+  ends.resize(2*nbond);
+  order.resize(nbond);
+  for (uint e=0; e<nbond; e++){
+    ends[2*e] = L.end(e,0);
+    ends[2*e+1] = L.end(e,1);
+  }
+  facemask.assign(nvert, 0);
+  for (uint d=0; d<6; d++){
+    for (auto v : L.face(d)){
+      facemask[v] |= 1<<d;
+    }
+  }
+  touched.resize(nvert);
+  for (uint d=0; d<3; d++){
+    first[d].assign(nbond+1, 0);
+  }
+}
+
+void newmanziff::trial(uint seed){
+/* Run a single trial: shuffle the bonds, then add them in turn and record how
+ * many were needed before each kind of crossing cluster first appeared.
+ * seed : seed value for rng
+ */
+  const unsigned char* masks = lattice::masks;
+  const uint dims[7] = {0,0,0,1,1,1,2};
+  bool found[3] = {false, false, false};
+  uint nfound=0, root, ru, rv, j;
+  gsl_rng* r = gsl_rng_alloc(gsl_rng_mt19937);
+  gsl_rng_set(r, seed);
+
+  // Fisher-Yates shuffle
+  for (uint e=0; e<nbond; e++){
+    order[e] = e;
+  }
+  for (uint e=nbond; e>1; e--){
+    j = gsl_rng_uniform_int(r, e);
+    std::swap(order[e-1], order[j]);
+  }
+  gsl_rng_free(r);
+
+  clusters.reset(nvert);
+  touched = facemask;
+  // A single vertex can already cross a lattice one cell thick
+  for (uint v=0; v<nvert && nfound<3; v++){
+    for (uint c=0; c<7; c++){
+      if (!found[dims[c]] && (touched[v] & masks[c]) == masks[c]){
+        found[dims[c]] = true;
+        first[dims[c]][0]++;
+        nfound++;
+      }
+    }
+  }
+  for (uint n=1; n<=nbond && nfound<3; n++){
+    ru = clusters.find(ends[2*order[n-1]]);
+    rv = clusters.find(ends[2*order[n-1]+1]);
+    if (ru == rv){
+      continue;
+    }
+    root = clusters.merge(ru, rv);
+    touched[root] = touched[ru] | touched[rv];
+    for (uint c=0; c<7; c++){
+      if (!found[dims[c]] && (touched[root] & masks[c]) == masks[c]){
+        found[dims[c]] = true;
+        first[dims[c]][n]++;
+        nfound++;
+      }
+    }
+  }
+  ntrials++;
+}
+
+double newmanziff::crossing(uint d, double p) const{
+/* Crossing probability at bond probability p. If Q(n) is the fraction of
+ * trials with a crossing once n bonds are present, this is
+ *   sum_n C(N,n) p^n (1-p)^(N-n) Q(n)
+ * with the binomial weights evaluated in log space.
+ * d : 0, 1 or 2 for 1D, 2D or 3D crossings
+ * p : bond probability
+ */
+  uint crossed=0;
+  double sum=0, logw, base, lp, lq;
+  if (ntrials == 0){
+    return NAN;
+  }
+  if (p <= 0 || p >= 1){
+    uint n = (p <= 0) ? 0 : nbond;
+    for (uint m=0; m<=n; m++){
+      crossed += first[d][m];
+    }
+    return crossed/(double)ntrials;
+  }
+  base = std::lgamma(nbond+1.);
+  lp = std::log(p);
+  lq = std::log1p(-p);
+  for (uint n=0; n<=nbond; n++){
+    crossed += first[d][n];
+    if (crossed == 0){
+      continue;
+    }
+    logw = base-std::lgamma(n+1.)-std::lgamma(nbond-n+1.)+n*lp+(nbond-n)*lq;
+    sum += std::exp(logw)*crossed;
+  }
+  return sum/ntrials;
+}
@@ -0,0 +1,83 @@
+/* philox.cc
+ * philox class
+ * - Counter-based random number generator, Philox4x32 with 10 rounds
+ * - Keyed by seed and trial, counter is the block number
+ * - Bulk generation laid out so the rounds vectorise across blocks
+ */
+
+#include "heads/philox.h"
+
+philox::philox(uint seed, uint trial){
+/* Constructor
+ * seed  : seed value, shared by all trials of a run
+ * trial : number of the trial within the run
+ */
+  key[0] = seed;
+  key[1] = trial;
+  last = (uint64_t)-1;
+}
+
+void philox::block(const uint32_t* k, uint64_t n, uint32_t* r){
+/* Evaluate Philox4x32-10 on the counter (n, 0) with key k.
+ * k : key, two words
+ * n : block number
+ * r : set to the four output words
+ */
+  const uint32_t m0=0xD2511F53, m1=0xCD9E8D57;  // Round multipliers
+  const uint32_t w0=0x9E3779B9, w1=0xBB67AE85;  // Key schedule increments
+  uint32_t k0=k[0], k1=k[1];
+  uint64_t a, b;
+  r[0] = (uint32_t)n;
+  r[1] = (uint32_t)(n>>32);
+  r[2] = 0;
+  r[3] = 0;
+  for (uint i=0; i<10; i++){
+    a = (uint64_t)m0*r[0];
+    b = (uint64_t)m1*r[2];
+    r[0] = (uint32_t)(b>>32) ^ r[1] ^ k0;
+    r[1] = (uint32_t)b;
+    r[2] = (uint32_t)(a>>32) ^ r[3] ^ k1;
+    r[3] = (uint32_t)a;
+    k0 += w0;
+    k1 += w1;
+  }
+}
+
+void philox::fill(uint64_t w, uint32_t* r) const{
+/* Compute numbers 64w ... 64w+63 of the stream, the same as get would give.
+ * The 16 blocks are kept one array per word of state, so that each round is
+ * a loop over blocks which the compiler turns into vector multiplies.
+ * w : number of the group of 64
+ * r : array of 64 words, overwritten
+ */
+  const uint32_t m0=0xD2511F53, m1=0xCD9E8D57;
+  const uint32_t w0=0x9E3779B9, w1=0xBB67AE85;
+  uint32_t k0=key[0], k1=key[1];
+  uint32_t x0[16], x1[16], x2[16], x3[16];
+  uint64_t a, b;
+  uint j;
+  for (j=0; j<16; j++){
+    x0[j] = (uint32_t)(16*w+j);
+    x1[j] = (uint32_t)((16*w+j)>>32);
+    x2[j] = 0;
+    x3[j] = 0;
+  }
+  for (uint i=0; i<10; i++){
+    for (j=0; j<16; j++){
+      a = (uint64_t)m0*x0[j];
+      b = (uint64_t)m1*x2[j];
+      x0[j] = (uint32_t)(b>>32) ^ x1[j] ^ k0;
+      x1[j] = (uint32_t)b;
+      x2[j] = (uint32_t)(a>>32) ^ x3[j] ^ k1;
+      x3[j] = (uint32_t)a;
+    }
+    k0 += w0;
+    k1 += w1;
+  }
+  for (j=0; j<16; j++){
+    r[4*j] = x0[j];
+    r[4*j+1] = x1[j];
+    r[4*j+2] = x2[j];
+    r[4*j+3] = x3[j];
+  }
+}
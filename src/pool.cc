@@ -0,0 +1,99 @@
+/* pool.cc
+ * Thread pool class
+ * - Work stealing over a range of task indices
+ * - Threads only live for the duration of a call to run
+ */
+
+#include "heads/pool.h"
+
+pool::pool(uint n) :
+    blocks(n ? n : std::max(1u, std::thread::hardware_concurrency())){
+/* Constructor
+ * n : number of worker threads. Zero for one per hardware thread
+ */
+  nthreads = blocks.size();
+}
+
+void pool::run(uint ntasks, const std::function<void(uint, uint)>& f){
+/* Run every task and wait for them all to finish. Tasks are dealt out to the
+ * workers in contiguous blocks to begin with.
+ * ntasks : number of tasks
+ * f      : task body, called as f(task, worker)
+ */
+  std::vector<std::thread> threads;
+  for (uint w=0; w<nthreads; w++){
+    blocks[w].next = (uint)((uint64_t)ntasks*w/nthreads);
+    blocks[w].end = (uint)((uint64_t)ntasks*(w+1)/nthreads);
+  }
+  for (uint w=1; w<nthreads; w++){
+    threads.push_back(std::thread(&pool::work, this, w, std::cref(f)));
+  }
+  work(0, f);
+  for (auto& t : threads){
+    t.join();
+  }
+}
+
+void pool::work(uint w, const std::function<void(uint, uint)>& f){
+/* Run tasks on worker w until there are none left anywhere
+ * w : worker index
+ * f : task body
+ */
+  uint task;
+  while (take(w, &task)){
+    f(task, w);
+  }
+}
+
+bool pool::take(uint w, uint* task){
+/* Get the next task for worker w, stealing if its own block is empty
+ * w    : worker index
+ * task : set to the task to run
+ * returns false once there is no work left to take
+ */
+  do{
+    std::lock_guard<std::mutex> guard(blocks[w].lock);
+    if (blocks[w].next < blocks[w].end){
+      *task = blocks[w].next++;
+      return true;
+    }
+  } while (steal(w));
+  return false;
+}
+
+bool pool::steal(uint w){
+/* Move the back half of the largest other block to worker w. Only the victim
+ * is locked while it is split, so two thieves can never deadlock.
+ * w : worker index (whose block is empty)
+ * returns false if every other block is empty
+ */
+  uint victim=w, most=0, n, next, end;
+  for (uint v=0; v<nthreads; v++){
+    if (v == w){
+      continue;
+    }
+    std::lock_guard<std::mutex> guard(blocks[v].lock);
+    n = blocks[v].end-blocks[v].next;
+    if (n > most){
+      most = n;
+      victim = v;
+    }
+  }
+  if (victim == w){
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> guard(blocks[victim].lock);
+    n = blocks[victim].end-blocks[victim].next;
+    if (n == 0){
+      return true; // Beaten to it. Look again
+    }
+    end = blocks[victim].end;
+    next = end-(n+1)/2;
+    blocks[victim].end = next;
+  }
+  std::lock_guard<std::mutex> guard(blocks[w].lock);
+  blocks[w].next = next;
+  blocks[w].end = end;
+  return true;
+}
@@ -0,0 +1,77 @@
+/* probe.cc
+ * probe class
+ * - Per-phase timers and counters for the trials of a sweep
+ * - Compiled in with PROBE, and written out as JSON lines
+ */
+
+#include "heads/probe.h"
+
+thread_local probe* probe::active = NULL;
+
+probe::probe(void){
+/* Constructor. Every time and count zero
+ */
+  std::fill(seconds, seconds+nphases, 0.);
+  std::fill(enqueued, enqueued+6, 0);
+  trials = closed = peak = 0;
+}
+
+void probe::timer::stop(void){
+/* Add the time since the timer was made to its phase of active, the first
+ * time this is called
+ */
+  if (on && running){
+    running = false;
+    if (active != NULL){
+      active->seconds[phase] += std::chrono::duration<double>(
+        std::chrono::steady_clock::now()-start).count();
+    }
+  }
+}
+
+void probe::add(const probe& P){
+/* Add the times and counts of another probe to these. Peaks take the larger
+ * P : probe to add
+ */
+  for (uint k=0; k<nphases; k++){
+    seconds[k] += P.seconds[k];
+  }
+  for (uint d=0; d<6; d++){
+    enqueued[d] += P.enqueued[d];
+  }
+  trials += P.trials;
+  closed += P.closed;
+  peak = std::max(peak, P.peak);
+}
+
+void probe::write(std::ostream& out, double p) const{
+/* Write the times and counts of the trials as one line of JSON. Trials per
+ * second are per thread, from the time spent in the trials themselves. The
+ * construction time is left to the other write, since it is not per point
+ * out : stream to write to
+ * p   : probability of forming bonds, to label the line with
+ */
+  const char* names[nphases] = {"construct", "percolate", "traverse",
+    "crossings"};
+  double busy=0;
+  out << "{\"p\":" << p << ",\"trials\":" << trials << ",\"seconds\":{";
+  for (uint k=construct+1; k<nphases; k++){
+    out << (k > construct+1 ? "," : "") << "\"" << names[k] << "\":" <<
+      seconds[k];
+    busy += seconds[k];
+  }
+  out << "},\"trials_per_second\":" << (busy > 0 ? trials/busy : 0) <<
+    ",\"closed\":" << closed << ",\"enqueued\":[";
+  for (uint d=0; d<6; d++){
+    out << (d ? "," : "") << enqueued[d];
+  }
+  out << "],\"peak_queue\":" << peak << "}\n";
+}
+
+void probe::write(std::ostream& out) const{
+/* Write the construction time as one line of JSON, for the head of a file
+ * of per-point lines
+ * out : stream to write to
+ */
+  out << "{\"seconds\":{\"construct\":" << seconds[construct] << "}}\n";
+}
@@ -0,0 +1,236 @@
+/* results.cc
+ * results class
+ * - Append-only binary file of per-trial crossing sizes, in columnar chunks
+ * - Resumable: trials already in the file are read back and skipped
+ * - Written by a background thread so trials never wait on the disk
+ */
+
+#include "heads/results.h"
+
+results::results(const std::string& file, const std::string& label,
+    const uint* dims, uint seed, uint nreps, const std::vector<double>& ps,
+    bool lengths, uint* sizes){
+/* Constructor
+ * Opens file for a sweep over ps with nreps trials per point, numbered as in
+ * run (trial t is repetition t%nreps at ps[t/nreps]). If the file already
+ * holds the same sweep, the sizes of the trials in it are copied into sizes
+ * and they are marked done. Otherwise it is started afresh, and if it held a
+ * different sweep that is kept, moved to file.1 (or file.2, ... if taken).
+ * file    : path of the results file
+ * label   : label of the unit cell
+ * dims    : dimensions of the lattice (3 values)
+ * seed    : seed value for rng
+ * nreps   : number of trials per point
+ * ps      : values of p
+ * lengths : whether the sizes are lengths, or only existence (see trial)
+ * sizes   : 3 sizes per trial, as set by trial. Filled in for trials in the
+ *           file
+ * Throws std::system_error if the file cannot be opened, moved aside or
+ * written, having closed it
+ */
+  std::vector<char> head;
+  std::string old;
+  struct stat st;
+  path = file;
+  npoints = ps.size();
+  this->nreps = nreps;
+  head = header(label, dims, seed, ps, lengths);
+  done.assign(npoints*nreps, false);
+  closing = false;
+  failed = 0;
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0){
+    fail("cannot open " + path);
+  }
+  if (!load(head, sizes)){
+    // New sweep, or a different one. A different one is moved out of the way
+    // to the first free file.1, file.2, ... rather than written over
+    if (fstat(fd, &st) == 0 && st.st_size > 0){
+      ::close(fd);
+      fd = -1;
+      for (uint k=1; old.empty() || access(old.c_str(), F_OK) == 0; k++){
+        old = path + "." + std::to_string(k);
+      }
+      if (rename(path.c_str(), old.c_str()) != 0){
+        fail("cannot move " + path + " to " + old);
+      }
+      std::cerr << "results: " << path << " holds a different sweep, moved "
+        "to " << old << std::endl;
+      fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0){
+        fail("cannot open " + path);
+      }
+    }
+    if (ftruncate(fd, 0) != 0 || ::write(fd, head.data(), head.size()) !=
+        (ssize_t)head.size()){
+      fail("cannot write " + path);
+    }
+    done.assign(npoints*nreps, false);
+  }
+  writer = std::thread(&results::write, this);
+}
+
+results::~results(void){
+/* Destructor. Writes out anything still queued
+ */
+  close();
+}
+
+void results::fail(const std::string& what){
+/* Give up on opening the file: close it if it is open, and throw
+ * std::system_error for the error in errno
+ * what : what could not be done
+ */
+  int err = errno;
+  if (fd >= 0){
+    ::close(fd);
+  }
+  throw std::system_error(err, std::generic_category(), "results: " + what);
+}
+
+std::vector<char> results::header(const std::string& label, const uint* dims,
+    uint seed, const std::vector<double>& ps, bool lengths) const{
+/* Lay out the header of the file (see class comment)
+ * returns the bytes of the header
+ */
+  uint32_t words[8] = {version, seed, nreps, npoints, dims[0], dims[1],
+    dims[2], lengths};
+  std::vector<char> head(8+sizeof(words)+32+ps.size()*sizeof(double), 0);
+  memcpy(head.data(), "percres1", 8);
+  memcpy(head.data()+8, words, sizeof(words));
+  memcpy(head.data()+8+sizeof(words), label.data(),
+    std::min(label.size(), (size_t)32));
+  memcpy(head.data()+8+sizeof(words)+32, ps.data(), ps.size()*sizeof(double));
+  return head;
+}
+
+bool results::load(const std::vector<char>& head, uint* sizes){
+/* Read back the trials of an existing file, if its header matches this
+ * sweep. The file is mapped and read in place. A chunk cut short by the job
+ * being killed is dropped, and the file truncated to the end of the last
+ * whole chunk, ready for appending.
+ * head  : header for this sweep
+ * sizes : 3 sizes per trial, filled in for each trial found
+ * returns false, having read nothing, if the file is empty or holds a
+ * different sweep
+ */
+  struct stat st;
+  const char* map;
+  const uint32_t* chunk;
+  uint64_t pos, n, len;
+  uint32_t t;
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < head.size()){
+    return false;
+  }
+  len = st.st_size;
+  map = (const char*)mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED){
+    return false;
+  }
+  if (memcmp(map, head.data(), head.size()) != 0){
+    munmap((void*)map, len);
+    return false;
+  }
+  for (pos=head.size(); pos+8<=len; pos+=8+16*n){
+    chunk = (const uint32_t*)(map+pos);
+    n = chunk[1];
+    if (chunk[0] != tag || pos+8+16*n > len){
+      break;
+    }
+    for (uint64_t i=0; i<n; i++){
+      t = chunk[2+i];
+      if (t >= done.size()){
+        continue;
+      }
+      done[t] = true;
+      for (uint k=0; k<3; k++){
+        sizes[3*t+k] = chunk[2+(k+1)*n+i];
+      }
+    }
+  }
+  munmap((void*)map, len);
+  if (pos != len && ftruncate(fd, pos) != 0){
+    return false;
+  }
+  lseek(fd, pos, SEEK_SET);
+  return true;
+}
+
+bool results::put(uint t, const uint* sizes){
+/* Queue a finished trial for the writer. Only takes the lock for long enough
+ * to copy four words
+ * t     : trial number
+ * sizes : its 1D, 2D and 3D sizes
+ * returns false, queueing nothing, if the writer has failed (see error)
+ */
+  std::lock_guard<std::mutex> guard(lock);
+  if (failed){
+    return false;
+  }
+  pending.push_back(t);
+  pending.insert(pending.end(), sizes, sizes+3);
+  done[t] = true;
+  return true;
+}
+
+void results::write(void){
+/* Body of the writer thread. About once a second, takes whatever trials are
+ * queued, lays them out as one chunk, appends it and flushes it to disk.
+ * Returns once close has been called and the queue is empty.
+ * A failed write is recorded in failed for put and close to hand back, and
+ * nothing more is written: the trials queued are dropped, and the file keeps
+ * the whole chunks before it (a partial one is dropped when it is next
+ * opened). The process carries on, as the trials are still in memory.
+ */
+  std::vector<uint32_t> batch, chunk;
+  uint n;
+  ssize_t k;
+  bool last=false;
+  while (!last){
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      wake.wait_for(guard, std::chrono::seconds(1), [&]{return closing;});
+      batch.swap(pending);
+      last = closing;
+    }
+    if (batch.empty()){
+      continue;
+    }
+    n = batch.size()/4;
+    chunk.assign(2+4*n, 0);
+    chunk[0] = tag;
+    chunk[1] = n;
+    for (uint i=0; i<n; i++){
+      for (uint k=0; k<4; k++){
+        chunk[2+k*n+i] = batch[4*i+k];
+      }
+    }
+    k = ::write(fd, chunk.data(), chunk.size()*sizeof(uint32_t));
+    if (k != (ssize_t)(chunk.size()*sizeof(uint32_t))){
+      std::lock_guard<std::mutex> guard(lock);
+      failed = (k < 0) ? errno : EIO; // A short write does not set errno
+      pending.clear();
+      return;
+    }
+    fdatasync(fd);
+    batch.clear();
+  }
+}
+
+bool results::close(void){
+/* Write out everything queued, stop the writer and close the file. Safe to
+ * call more than once
+ * returns false if any trial could not be written (see error)
+ */
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (closing){
+      return !failed;
+    }
+    closing = true;
+  }
+  wake.notify_one();
+  writer.join();
+  ::close(fd);
+  return !failed;
+}
@@ -0,0 +1,257 @@
+/* shard.cc
+ * shard class
+ * - Coordinator handing out units of trials over a local Unix socket
+ * - Units held by a worker that goes away are put back on the queue
+ * - Workers naming another sweep are refused
+ * - Worker loop running units for a coordinator
+ */
+
+#include "heads/shard.h"
+
+shard::shard(const std::string& path, const std::string& sweep){
+/* Constructor
+ * Creates a socket at path and listens on it, replacing any socket left
+ * there by a coordinator that was killed. Workers can connect from now on,
+ * though they are not served until serve is called.
+ * path  : path of the socket
+ * sweep : name of the sweep, which workers must give to be served
+ */
+  sockaddr_un addr;
+  this->path = path;
+  this->sweep = sweep;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)){
+    std::cerr << "shard: socket path too long: " << path << std::endl;
+    exit(1);
+  }
+  strcpy(addr.sun_path, path.c_str());
+  unlink(path.c_str());
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+      listen(listener, 64) != 0){
+    std::cerr << "shard: cannot listen on " << path << std::endl;
+    exit(1);
+  }
+}
+
+shard::~shard(void){
+/* Destructor. Closes the socket if serve has not, and removes it
+ */
+  if (listener >= 0){
+    close(listener);
+  }
+  unlink(path.c_str());
+}
+
+bool shard::full(int fd, void* buf, size_t n, bool out){
+/* Read or write all of a buffer, however many calls it takes
+ * fd  : socket
+ * buf : buffer
+ * n   : number of bytes
+ * out : true to write, false to read
+ * returns false if the other end has gone away
+ */
+  char* b = (char*)buf;
+  ssize_t k;
+  while (n > 0){
+    k = out ? send(fd, b, n, MSG_NOSIGNAL) : recv(fd, b, n, 0);
+    if (k <= 0){
+      return false;
+    }
+    b += k;
+    n -= k;
+  }
+  return true;
+}
+
+bool shard::serve(const std::vector<unit>& units, uint* sizes,
+    std::vector<pid_t>* workers){
+/* Hand out units to the workers which connect, and gather their results.
+ * Workers asking while every unit left is out with another worker are kept
+ * waiting, in case that worker goes away and its unit is put back. Workers
+ * naming another sweep are refused. Returns once every unit has come back,
+ * having told every worker still connected to stop and stopped listening.
+ * Workers still waiting to be accepted are told to stop too, and later ones
+ * are refused, so none of them is left waiting for a coordinator which has
+ * finished. Can only be called once.
+ * units   : units to run. Their ids must be their positions in units
+ * sizes   : 3 sizes per trial, trial t at sizes[3*t]. Set as units come back
+ * workers : child processes started to run units, or NULL. Those which exit
+ *           are reaped and taken out. Once none is left and no other worker
+ *           is connected, nobody is going to run the units left, so serve
+ *           gives up on them
+ * returns true if every unit came back, false if serve gave up
+ */
+  const uint32_t none=(uint32_t)-1, refused=(uint32_t)-2;
+  std::vector<pollfd> fds(1);       // The listener, then one per worker
+  std::vector<uint32_t> held(1);    // Unit held by each worker, none if idle
+  std::vector<bool> named(1);       // Whether each worker has named the sweep
+  std::deque<uint32_t> todo;        // Units not yet handed out
+  std::vector<uint32_t> got;
+  std::string name;
+  uint32_t head[2];
+  uint remaining=units.size();
+  unit stop, refuse;
+  bool ok;
+  stop.id = none;
+  refuse.id = refused;
+  for (uint32_t u=0; u<units.size(); u++){
+    todo.push_back(u);
+  }
+  fds[0].fd = listener;
+  fds[0].events = POLLIN;
+  while (remaining > 0){
+    // Wake up now and then to see whether the workers started are still there
+    if (poll(fds.data(), fds.size(), workers ? 100 : -1) < 0){
+      continue;
+    }
+    if (fds[0].revents & POLLIN){
+      pollfd client = {accept(listener, NULL, NULL), POLLIN, 0};
+      if (client.fd >= 0){
+        fds.push_back(client);
+        held.push_back(none);
+        named.push_back(false);
+      }
+    }
+    for (uint k=1; k<fds.size(); k++){
+      if (!fds[k].revents){
+        continue;
+      }
+      ok = full(fds[k].fd, head, sizeof(head), false);
+      if (ok && !named[k]){
+        // First message, naming the sweep the worker runs
+        name.assign(head[1] == sweep.size() ? head[1] : 0, ' ');
+        ok = (head[0] == none && full(fds[k].fd, &name[0], name.size(),
+          false));
+        if (ok && (head[1] != sweep.size() || name != sweep)){
+          full(fds[k].fd, &refuse, sizeof(unit), true);
+          ok = false;
+        }
+        named[k] = ok;
+      }
+      else if (ok){
+        // Results of the unit the worker holds
+        ok = (held[k] != none && head[0] == held[k] &&
+          head[1] == units[held[k]].count);
+        got.resize(3*head[1]);
+        ok = ok && full(fds[k].fd, got.data(), got.size()*sizeof(uint32_t),
+          false);
+        if (ok){
+          std::copy(got.begin(), got.end(), sizes+3*units[held[k]].first);
+          held[k] = none;
+          remaining--;
+        }
+      }
+      if (!ok){
+        // Gone away, or talking nonsense. Its unit goes to someone else
+        if (held[k] != none){
+          todo.push_front(held[k]);
+        }
+        close(fds[k].fd);
+        fds.erase(fds.begin()+k);
+        held.erase(held.begin()+k);
+        named.erase(named.begin()+k);
+        k--;
+        continue;
+      }
+      fds[k].events = 0;            // Idle until given a unit
+    }
+    // Give out units to the idle workers, or tell them to stop if all done
+    for (uint k=1; k<fds.size(); k++){
+      if (fds[k].events || held[k] != none){
+        continue;
+      }
+      if (!todo.empty()){
+        held[k] = todo.front();
+        if (full(fds[k].fd, (void*)&units[held[k]], sizeof(unit), true)){
+          todo.pop_front();
+          fds[k].events = POLLIN;
+        }
+        else{
+          held[k] = none;           // Dealt with when poll reports it gone
+          fds[k].events = POLLIN;
+        }
+      }
+    }
+    if (workers){
+      for (uint k=0; k<workers->size(); k++){
+        if (waitpid((*workers)[k], NULL, WNOHANG) == (*workers)[k]){
+          workers->erase(workers->begin()+k);
+          k--;
+        }
+      }
+      if (workers->empty() && fds.size() == 1){
+        break;
+      }
+    }
+  }
+  for (uint k=1; k<fds.size(); k++){
+    if (held[k] == none){
+      full(fds[k].fd, &stop, sizeof(unit), true);
+    }
+    close(fds[k].fd);
+  }
+  // Stop listening. Other processes may share the listener, having been
+  // forked from this one, so closing it is not enough: shut it down to
+  // refuse new workers, and tell those already waiting to stop
+  shutdown(listener, SHUT_RDWR);
+  fcntl(listener, F_SETFL, O_NONBLOCK);
+  for (int fd; (fd = accept(listener, NULL, NULL)) >= 0; ){
+    full(fd, &stop, sizeof(unit), true);
+    close(fd);
+  }
+  close(listener);
+  listener = -1;
+  return remaining == 0;
+}
+
+bool shard::work(const std::string& path, const std::string& sweep,
+    const std::function<void(const unit&, uint*)>& body){
+/* Worker loop. Connects to the coordinator, waiting for up to a minute for its
+ * socket to appear, then runs units until told to stop or the coordinator
+ * goes away. Gives up at once if the socket is there but nobody is listening,
+ * as once serve has returned.
+ * path  : path of the coordinator's socket
+ * sweep : name of the sweep body runs, which must be the coordinator's
+ * body  : runs a unit, setting 3 sizes for each of its trials in order
+ * returns true if told to stop, false if it could not connect, was refused
+ *   or the coordinator went away
+ */
+  const uint32_t none=(uint32_t)-1, refused=(uint32_t)-2;
+  sockaddr_un addr;
+  std::vector<uint32_t> msg(2);
+  unit u;
+  bool ok;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path)-1);
+  for (uint tries=0; connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0;
+      tries++){
+    if ((errno != ENOENT && errno != EAGAIN) || tries == 600){
+      std::cerr << "shard: cannot connect to " << path << std::endl;
+      close(fd);
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  msg[0] = none;
+  msg[1] = sweep.size();
+  ok = full(fd, msg.data(), msg.size()*sizeof(uint32_t), true) &&
+    full(fd, (void*)sweep.data(), sweep.size(), true);
+  while (ok && (ok = full(fd, &u, sizeof(u), false)) && u.id != none &&
+      u.id != refused){
+    msg.assign(2+3*u.count, 0);
+    msg[0] = u.id;
+    msg[1] = u.count;
+    body(u, msg.data()+2);
+    ok = full(fd, msg.data(), msg.size()*sizeof(uint32_t), true);
+  }
+  close(fd);
+  if (ok && u.id == refused){
+    std::cerr << "shard: " << path << " is not serving " << sweep <<
+      std::endl;
+  }
+  return ok && u.id == none;
+}
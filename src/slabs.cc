@@ -0,0 +1,305 @@
+/* slabs.cc
+ * slabs class
+ * - Implicit lattice with its distances in a memory-mapped file
+ * - Bond states worked out a slab at a time, never stored in full
+ * - Traversal a slab at a time, repeated until the distances settle
+ */
+
+#include "heads/slabs.h"
+
+slabs::slabs(const lattice_t& D, uint L, uint M, uint N,
+    const std::string& file, uint depth) : implicit(D, L, M, N, false),
+    rng(314, 0){
+/* Constructor
+ * Sets up an LxMxN lattice with unit cell D, with every bond closed, and
+ * creates the file for its distances (24 bytes per vertex)
+ * L,M,N : dimensions of lattice
+ * D     : lattice_t object describing unit cell. Bonds may only join unit
+ *         cells in neighbouring z layers
+ * file  : path of the scratch file. Overwritten if it exists
+ * depth : number of z layers in each slab. Memory use is about 7 bytes per
+ *         vertex of a slab. Zero to use slabs of about 2^24 vertices
+ * A unit cell with bonds spanning more than one z layer is refused with
+ * std::invalid_argument, and a file which cannot be created or mapped with
+ * std::system_error, having closed and removed whatever was made of it
+ */
+  int err;
+  path = file;
+  layer = (uint64_t)ncell*L*M;
+  if (depth == 0){
+    depth = (layer == 0) ? 1 :
+      std::max((uint64_t)1, ((uint64_t)1<<24)/layer);
+  }
+  this->depth = std::max(1u, std::min(depth, N));
+  nslabs = (N+this->depth-1)/this->depth;
+  threshold = 0;
+  for (uint k=0; k<3; k++){
+    held[k] = -1;
+  }
+  for (uint w=0; w<ncell; w++){
+    for (uint i=0; i<degree[w]; i++){
+      if (links[8*w+i].k < -1 || links[8*w+i].k > 1){
+        throw std::invalid_argument("slabs: unit cell bonds span more than "
+          "one z layer");
+      }
+    }
+  }
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, 6*size*sizeof(uint32_t)) != 0){
+    err = errno;
+    if (fd >= 0){
+      close(fd);
+      unlink(path.c_str());
+    }
+    throw std::system_error(err, std::generic_category(),
+      "slabs: cannot create " + path);
+  }
+  dist = NULL;
+  if (size > 0){
+    dist = (uint32_t*)mmap(NULL, 6*size*sizeof(uint32_t),
+      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (dist == MAP_FAILED){
+      err = errno;
+      close(fd);
+      unlink(path.c_str());
+      throw std::system_error(err, std::generic_category(),
+        "slabs: cannot map " + path);
+    }
+    madvise(dist, 6*size*sizeof(uint32_t), MADV_SEQUENTIAL);
+  }
+}
+
+slabs::~slabs(void){
+/* Destructor. Unmaps and removes the distance file
+ */
+  if (dist != NULL){
+    munmap(dist, 6*size*sizeof(uint32_t));
+  }
+  close(fd);
+  unlink(path.c_str());
+}
+
+void slabs::percolate(double p, uint seed, uint trial){
+/* Percolate the lattice: open each bond independently with probability p.
+ * Nothing is drawn here. Bond states are worked out for each layer as
+ * traverse needs them, and match implicit::percolate with the same arguments.
+ * p     : probability of forming bonds.
+ * seed  : seed value for rng
+ * trial : trial number. Trials with the same seed are independent
+ */
+  rng = philox(seed, trial);
+  threshold = philox::threshold(p);
+  for (uint k=0; k<3; k++){
+    held[k] = -1;
+  }
+}
+
+template<class C>
+uint8_t slabs::slots(const C& cell, uint64_t n){
+/* Open slots of vertex n, bit i for slot i, as implicit keeps them in open.
+ * Each bond is drawn from the end implicit::percolate draws it from, so both
+ * ends agree whichever slab they are in. Results are kept for the slab of n,
+ * which replaces the slab three before or after it.
+ * cell : unit cell, cells::fixed or runtime
+ * n    : vertex
+ */
+  uint s = n/((uint64_t)depth*layer), k = s%3;
+  uint64_t j = n-first(s), u, id;
+  uint c[4];
+  int back;
+  if (held[k] != (int)s){
+    bonds[k].assign(count(s), 0);
+    known[k].assign(count(s), false);
+    held[k] = s;
+  }
+  if (known[k][j]){
+    return bonds[k][j];
+  }
+  toCoord(cell, n, c);
+  for (uint i=0; i<cell.degree(c[0]); i++){
+    if (!neighbour(cell, c, i, &u)){
+      continue;
+    }
+    back = reverse[8*c[0]+i];
+    if (back < 0 || u > n || (u == n && back >= (int)i)){
+      id = 8*n+i;
+    }
+    else{
+      id = 8*u+back;
+    }
+    if (rng.get(id) < threshold){
+      bonds[k][j] |= 1<<i;
+    }
+  }
+  known[k][j] = true;
+  return bonds[k][j];
+}
+
+template<class C>
+uint slabs::solve(const C& cell, uint32_t* d, uint s, bool all){
+/* Bring the distances within slab s up to date with the distances on either
+ * side of it. Distances only ever go down, so only vertices which get a
+ * shorter path across the faces of the slab need to start a search: a bfs
+ * within the slab takes them in order of distance, from the sorted starting
+ * points and its own queue together, and follows only bonds which shorten
+ * a distance.
+ * cell : unit cell, cells::fixed or runtime
+ * d    : distances in the current direction
+ * s    : slab
+ * all  : whether to start from every visited vertex, the first time the slab
+ *        is solved
+ * returns 1 if the bottom layer of the slab changed, plus 2 if the top layer
+ * did
+ */
+  const uint32_t unvisited = (uint32_t)-1;
+  uint64_t base=first(s), n=count(s), from, v;
+  uint c[4], bits, j, head=0, next=0, changed=0;
+  uint32_t t;
+  sources.clear();
+  for (j=0; all && j<n; j++){
+    if (d[base+j] != unvisited){
+      sources.push_back(std::make_pair(d[base+j], j));
+    }
+  }
+  // Bonds into the slab from the top layer of the slab below and the bottom
+  // layer of the slab above
+  for (int side=-1; side<=1; side+=2){
+    if ((side < 0 && s == 0) || (side > 0 && s+1 == nslabs)){
+      continue;
+    }
+    from = (side < 0) ? base-layer : base+n;
+    for (j=0; j<layer; j++){
+      t = d[from+j];
+      if (t == unvisited || (bits = slots(cell, from+j)) == 0){
+        continue;
+      }
+      toCoord(cell, from+j, c);
+      for (; bits; bits&=bits-1){
+        neighbour(cell, c, __builtin_ctz(bits), &v);
+        if (v >= base && v < base+n && t+1 < d[v]){
+          d[v] = t+1;
+          sources.push_back(std::make_pair(t+1, v-base));
+        }
+      }
+    }
+  }
+  std::sort(sources.begin(), sources.end());
+  fifo.clear();
+  while (next < sources.size() || head < fifo.size()){
+    if (head == fifo.size() || (next < sources.size() &&
+        sources[next].first <= d[base+fifo[head]])){
+      j = sources[next].second;
+      if (d[base+j] != sources[next++].first){
+        continue; // Since shortened, and queued again
+      }
+    }
+    else{
+      j = fifo[head++];
+    }
+    changed |= (j < layer) | (j >= n-layer)<<1;
+    t = d[base+j]+1;
+    toCoord(cell, base+j, c);
+    for (bits=slots(cell, base+j); bits; bits&=bits-1){
+      neighbour(cell, c, __builtin_ctz(bits), &v);
+      if (v >= base && v < base+n && t < d[v]){
+        d[v] = t;
+        fifo.push_back(v-base);
+      }
+    }
+  }
+  return changed;
+}
+
+void slabs::advise(const uint32_t* d, uint s, int advice){
+/* Pass advice to madvise for the pages holding slab s of d
+ * d      : distances in one direction
+ * s      : slab
+ * advice : MADV_WILLNEED to read it ahead, MADV_DONTNEED to let it go
+ */
+  uintptr_t a = (uintptr_t)(d+first(s));
+  uintptr_t b = (uintptr_t)(d+first(s)+count(s));
+  a -= a%sysconf(_SC_PAGESIZE);
+  madvise((void*)a, b-a, advice);
+}
+
+template<class C>
+void slabs::traverse(const C& cell){
+/* Find the distance of every vertex from the start and end faces, as
+ * lattice::traverse does. Passes go up and down the slabs, solving each slab
+ * next to a face which changed, until a pass finds nothing to do. Within a
+ * pass the next slab is read ahead and the one two behind is released.
+ * cell : unit cell, cells::fixed or runtime
+ */
+  std::vector<bool> dirty, fresh;
+  uint32_t* d;
+  uint s, changed;
+  bool up;
+  for (uint dir=0; dir<6; dir++){
+    d = dist+dir*size;
+    std::fill(d, d+size, (uint32_t)-1);
+    face(dir, [&](uint64_t v){
+      d[v] = 0;
+    });
+    dirty.assign(nslabs, true);
+    fresh.assign(nslabs, true);
+    up = true;
+    while (std::find(dirty.begin(), dirty.end(), true) != dirty.end()){
+      for (uint k=0; k<nslabs; k++){
+        s = up ? k : nslabs-1-k;
+        if (!dirty[s]){
+          continue;
+        }
+        if (up ? s+1 < nslabs : s > 0){
+          advise(d, up ? s+1 : s-1, MADV_WILLNEED);
+        }
+        dirty[s] = false;
+        changed = solve(cell, d, s, fresh[s]);
+        fresh[s] = false;
+        if ((changed & 1) && s > 0){
+          dirty[s-1] = true;
+        }
+        if ((changed & 2) && s+1 < nslabs){
+          dirty[s+1] = true;
+        }
+        if (up ? s >= 2 : s+2 < nslabs){
+          advise(d, up ? s-2 : s+2, MADV_DONTNEED);
+        }
+      }
+      up = !up;
+    }
+  }
+}
+
+void slabs::traverse(){
+/* Find the distance of every vertex from the start and end faces, using the
+ * kernel compiled for the unit cell if there is one
+ */
+  if (size == 0){
+    return;
+  }
+  switch (kernel){
+    case 1: traverse(cells::fixed<cells::cubic>()); break;
+    case 2: traverse(cells::fixed<cells::raussendorf>()); break;
+    case 3: traverse(cells::fixed<cells::diamond>()); break;
+    case 4: traverse(cells::fixed<cells::diamond_grid>()); break;
+    default: traverse(runtime{*this}); break;
+  }
+}
+
+std::vector<uint> slabs::findCrossings(){
+/* Find the size of the smallest crossing clusters after traverse, in the same
+ * form as lattice::findCrossings. Reads the six distance arrays front to back.
+ */
+  std::vector<uint> minsizes(7,(uint)-1);
+  const uint32_t* d[6];
+  for (uint k=0; k<6; k++){
+    d[k] = dist+k*size;
+  }
+  lattice::crossings(d, size, minsizes.data());
+  for (uint i=0; i<7; i++){
+    if (minsizes[i] != (uint)-1){
+      minsizes[i]++;
+    }
+  }
+  return minsizes;
+}
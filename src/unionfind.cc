@@ -0,0 +1,69 @@
+/* unionfind.cc
+ * Disjoint set (union-find) class
+ * - Path compression and union by rank, so a sequence of m operations on n
+ *   elements costs O(m a(n))
+ * - No knowledge of the graph it is labelling
+ */
+
+#include "heads/unionfind.h"
+
+unionfind::unionfind(void){
+/* Empty constructor. Creates a forest with no elements
+ */
+}
+
+unionfind::unionfind(uint n){
+/* Size constructor. Creates n singleton sets
+ * n : number of elements
+ */
+  reset(n);
+}
+
+void unionfind::reset(uint n){
+/* Return to n singleton sets. Storage is reused if n does not grow, so a
+ * single object can be used for many trials.
+ * n : number of elements
+ */
+  parent.resize(n);
+  rank.assign(n, 0);
+  for (uint i=0; i<n; i++){
+    parent[i] = i;
+  }
+}
+
+uint unionfind::find(uint i){
+/* Find the root of the set containing i, compressing the path on the way
+ * i : element to look up
+ */
+  uint root=i, next;
+  while (parent[root] != root){
+    root = parent[root];
+  }
+  while (parent[i] != root){
+    next = parent[i];
+    parent[i] = root;
+    i = next;
+  }
+  return root;
+}
+
+uint unionfind::merge(uint i, uint j){
+/* Merge the sets containing i and j. The shallower tree is attached below the
+ * root of the deeper one.
+ * i, j : elements whose sets are merged
+ * returns the root of the merged set
+ */
+  i = find(i);
+  j = find(j);
+  if (i == j){
+    return i;
+  }
+  if (rank[i] < rank[j]){
+    std::swap(i, j);
+  }
+  parent[j] = i;
+  if (rank[i] == rank[j]){
+    rank[i]++;
+  }
+  return i;
+}